@@ -1,6 +1,7 @@
 #include "chessengine.h"
 #include <base/memory.h>
 // stockfish
+#include <stockfish/src/analysisdb.h>
 #include <stockfish/src/bitboard.h>
 #include <stockfish/src/position.h>
 #include <stockfish/src/search.h>
@@ -8,11 +9,19 @@
 #include <stockfish/src/tt.h>
 #include <stockfish/src/uci.h>
 #include <stockfish/src/evaluate.h>
+#include <stockfish/src/movegen.h>
 #include <stockfish/src/polybook.h>
 #include <stockfish/src/syzygy/tbprobe.h>
 // std
+#include <condition_variable>
 #include <iostream>
 #include <fstream>
+#include <list>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <tuple>
+#include <unordered_map>
 
 //#define TEST
 
@@ -24,6 +33,7 @@ namespace ChessNetwork {
 
 struct MoveInfo {
     Move move;
+    Move ponder = MOVE_NONE; // Expected reply
     int depth = 0;
     int selDepth = 0;
     float score = 0.0f;
@@ -34,29 +44,331 @@ struct MoveInfo {
 };
 
 // Globals
-static MultiMap<float, MoveInfo> g_bestMoves;
-static std::mutex g_thinkLock;
+static std::mutex g_thinkLock;  // Held by a request for its whole search
+static std::mutex g_resultLock; // Guards the moves handed to the caller and their position
+static const char* StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+static const int Rejected = -2; // GenerateMoves result when the queue is full
+
+// Copies the states of pos from the last irreversible move on, which is all that
+// repetition detection looks at, so that a search owns its history while the
+// game goes on. The last state is the one of pos.
+static StateListPtr CopyStates(const Position& pos) {
+    int count = std::min(pos.rule50_count(), pos.state()->pliesFromNull) + 1;
+    StateListPtr copy(new std::deque<StateInfo>(count));
+    StateInfo* st = pos.state();
+    for (int i = count - 1; i >= 0; --i, st = st->previous) {
+        (*copy)[i] = *st;
+    }
+    (*copy)[0].previous = nullptr;
+    for (int i = 1; i < count; ++i) {
+        (*copy)[i].previous = &(*copy)[i - 1];
+    }
+    return copy;
+}
 
-// StockfishChessEngine
-class StockfishChessEngine : public ChessEngine {
+// Search knowledge kept between the moves of a game: the main thread's move
+// ordering histories, its time management state and the last PV
+struct SearchMemory {
+    ButterflyHistory mainHistory;
+    CounterMoveHistory counterMoves;
+    ContinuationHistory continuationHistory[2][2];
+    Value bestPreviousScore;
+    double previousTimeReduction;
+    Key pvKey;
+    std::vector<Move> pv;
+};
+
+// StockfishChessGame
+class StockfishChessGame : public ChessGame {
 
 public:
-    virtual ~StockfishChessEngine() {
+    void SetPosition(const String& fenString) final {
+        states = StateListPtr(new std::deque<StateInfo>(1));
+        moves.clear();
+        position.set(fenString.c_str(), false, &states->back(), Threads.main());
+    }
+
+    bool PushMove(const String& move) final {
+        std::string str(move.c_str(), move.length());
+        Move m = UCI::to_move(position, str);
+        if (m == MOVE_NONE) {
+            return false;
+        }
+        states->emplace_back();
+        position.do_move(m, states->back());
+        moves.push_back(m);
+        return true;
+    }
+
+    bool PopMove() final {
+        if (moves.empty()) {
+            return false;
+        }
+        position.undo_move(moves.back());
+        states->pop_back();
+        moves.pop_back();
+        return true;
+    }
+
+    String GetFen() const final {
+        auto fen = position.fen();
+        return String(fen.c_str(), fen.length());
+    }
+
+    void SetPriority(int tier) final {
+        priority = tier;
     }
 
-    void OnMove(Move move, int depth, int selDepth, Value v) {
-        MoveInfo moveInfo = {move, depth, selDepth, (float)v};
-        if (g_bestMoves.size() > 0) {
-            auto pair = g_bestMoves.end();
-            pair--;
+    int GetPriority() const {
+        return priority;
+    }
 
-            int previousDepth = pair->second.depth;
-            if (moveInfo.depth > previousDepth) {
-                g_bestMoves.clear();
+    const Position& GetPosition() const {
+        return position;
+    }
+
+    // Loads the search memory of the game into the main thread, and the rest of
+    // the last PV as the expected one if the game went on along it since then
+    void Restore(Search::LimitsType& limits) const {
+        if (!memory) {
+            return;
+        }
+        MainThread* th = Threads.main();
+        th->mainHistory = memory->mainHistory;
+        th->counterMoves = memory->counterMoves;
+        std::copy(&memory->continuationHistory[0][0], &memory->continuationHistory[0][0] + 4, &th->continuationHistory[0][0]);
+        th->bestPreviousScore = memory->bestPreviousScore;
+        th->previousTimeReduction = memory->previousTimeReduction;
+
+        const std::vector<Move>& pv = memory->pv;
+        for (size_t k = 1; k < pv.size() && k <= moves.size(); ++k) {
+            if ((*states)[states->size() - 1 - k].key == memory->pvKey) {
+                if (std::equal(pv.begin(), pv.begin() + k, moves.end() - k)) {
+                    limits.rootPV.assign(pv.begin() + k, pv.end());
+                }
+                break;
             }
         }
+    }
 
-        g_bestMoves.insert({moveInfo.score, moveInfo});
+    void Store(const Search::PVRecord& best) const {
+        if (!memory) {
+            memory.reset(new SearchMemory);
+        }
+        MainThread* th = Threads.main();
+        memory->mainHistory = th->mainHistory;
+        memory->counterMoves = th->counterMoves;
+        std::copy(&th->continuationHistory[0][0], &th->continuationHistory[0][0] + 4, &memory->continuationHistory[0][0]);
+        memory->bestPreviousScore = th->bestPreviousScore;
+        memory->previousTimeReduction = th->previousTimeReduction;
+        memory->pvKey = position.key();
+        memory->pv.assign(best.pv, best.pv + best.pvLength);
+    }
+
+private:
+    StateListPtr states;
+    Position position;
+    std::vector<Move> moves;
+    int priority = 1;
+    mutable std::unique_ptr<SearchMemory> memory; // Not part of the game state
+};
+
+// ThinkQueue orders concurrent move requests by priority tier, then by deadline,
+// and lets one think at a time. A request that waited gets the time left until
+// its deadline, but at least a tenth of its move time. When the queue is full a
+// new request displaces the last waiting one if it goes before it.
+class ThinkQueue {
+
+public:
+    struct Request {
+        int tier;
+        TimePoint deadline;
+        int maxTime;
+        uint64_t seq;
+        int budget; // Move time granted, set by Enter()
+
+        bool operator<(const Request& other) const {
+            return std::tie(tier, deadline, seq) < std::tie(other.tier, other.deadline, other.seq);
+        }
+    };
+
+    // Waits for the turn of the request. Returns false if it is rejected.
+    bool Enter(Request& r) {
+        std::unique_lock<std::mutex> lock(mutex);
+        TimePoint arrival = now();
+        r.seq = ++sequence;
+        if (limit && (int)waiting.size() >= limit) {
+            auto last = std::prev(waiting.end());
+            if (!(r < *last)) {
+                ++rejected;
+                return false;
+            }
+            displaced.insert(last->seq);
+            waiting.erase(last);
+            cv.notify_all();
+        }
+        waiting.insert(r);
+        maxQueued = std::max(maxQueued, waiting.size());
+        cv.wait(lock, [&] { return displaced.count(r.seq) || (!busy && waiting.begin()->seq == r.seq); });
+        if (displaced.erase(r.seq)) {
+            ++rejected;
+            return false;
+        }
+        waiting.erase(waiting.begin());
+        busy = true;
+
+        TimePoint t = now();
+        r.budget = (int)std::clamp(r.deadline - t, TimePoint(r.maxTime / 10), TimePoint(r.maxTime));
+        shortened += r.budget < r.maxTime;
+        totalWait += t - arrival;
+        longestWait = std::max(longestWait, t - arrival);
+        ++admitted;
+        return true;
+    }
+
+    void Leave() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy = false;
+        }
+        cv.notify_all();
+    }
+
+    void SetLimit(int maxWaiting) {
+        std::lock_guard<std::mutex> lock(mutex);
+        limit = std::max(maxWaiting, 0);
+    }
+
+    std::string Stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::stringstream ss;
+        ss << "Queued        " << waiting.size() << "\n"
+           << "Max queued    " << maxQueued << "\n"
+           << "Admitted      " << admitted << "\n"
+           << "Rejected      " << rejected << "\n"
+           << "Shortened     " << shortened << "\n"
+           << "Average wait  " << (admitted ? totalWait / admitted : 0) << " ms\n"
+           << "Longest wait  " << longestWait << " ms";
+        return ss.str();
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    std::set<Request> waiting;
+    std::set<uint64_t> displaced; // Requests pushed out of a full queue
+    bool busy = false;
+    int limit = 0;
+    uint64_t sequence = 0;
+    size_t maxQueued = 0;
+    uint64_t admitted = 0, rejected = 0, shortened = 0;
+    TimePoint totalWait = 0, longestWait = 0;
+};
+
+// Holds the turn of a move request in the ThinkQueue for the scope of the call
+class ThinkTurn {
+
+public:
+    ThinkTurn(ThinkQueue& q, int tier, int maxTime) : queue(q) {
+        request = {tier, now() + maxTime, maxTime, 0, maxTime};
+        admitted = queue.Enter(request);
+    }
+
+    ~ThinkTurn() {
+        if (admitted) {
+            queue.Leave();
+        }
+    }
+
+    ThinkQueue& queue;
+    ThinkQueue::Request request;
+    bool admitted;
+};
+
+// ResultCache keeps the moves of recent requests, dropping the least recently
+// used one when full. A stored request is reused with the set probability only,
+// otherwise it is searched again and its entry refreshed.
+class ResultCache {
+
+public:
+    void SetSize(int maxEntries, int reusePercent) {
+        std::lock_guard<std::mutex> lock(mutex);
+        capacity = (size_t)std::max(maxEntries, 0);
+        reuse = std::clamp(reusePercent, 0, 100);
+        entries.clear();
+        index.clear();
+    }
+
+    bool Find(Key key, std::vector<MoveInfo>& moves, int& count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it == index.end() || int(rng.rand<uint64_t>() % 100) >= reuse) {
+            return false;
+        }
+        entries.splice(entries.begin(), entries, it->second); // Now the most recent
+        moves = it->second->moves;
+        count = it->second->count;
+        return true;
+    }
+
+    void Store(Key key, const std::vector<MoveInfo>& moves, int count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!capacity) {
+            return;
+        }
+        auto it = index.find(key);
+        if (it != index.end()) {
+            entries.erase(it->second);
+        } else if (index.size() >= capacity) {
+            index.erase(entries.back().key);
+            entries.pop_back();
+        }
+        entries.push_front({key, moves, count});
+        index[key] = entries.begin();
+    }
+
+    // Key of a request: the position and its fifty-move counter mixed with the
+    // parameters shaping the result
+    static Key RequestKey(const Position& pos, std::initializer_list<int> params) {
+        Key key = make_key(pos.key() ^ (uint64_t)pos.rule50_count());
+        for (int p : params) {
+            key = make_key(key ^ (uint64_t)p);
+        }
+        return key;
+    }
+
+private:
+    struct Entry {
+        Key key;
+        std::vector<MoveInfo> moves;
+        int count;
+    };
+
+    std::mutex mutex;
+    std::list<Entry> entries; // Most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator> index;
+    size_t capacity = 0;
+    int reuse = 100;
+    PRNG rng{(uint64_t)now()};
+};
+
+// StockfishChessEngine
+class StockfishChessEngine : public ChessEngine {
+
+public:
+    virtual ~StockfishChessEngine() {
+        StopPonderSearch();
+    }
+
+    // Called on the search thread for each reported PV line. Lines come ranked,
+    // and each report starts again from the first one, so searchMoves always
+    // holds the latest report.
+    void OnResult(const Search::PVRecord& r) {
+        if (r.multiPV == 1) {
+            searchMoves.clear();
+            bestLine = r;
+        }
+        searchMoves.push_back({r.move(), r.pvLength > 1 ? r.pv[1] : MOVE_NONE, r.depth, r.selDepth, (float)r.score});
     }
 
     bool Initialize(int hashTableSizeInMegaBytes, int maxMoveCount) final {
@@ -75,9 +387,11 @@ public:
 
         Options["MultiPV"] = std::to_string(maxMoveCount);
         Options["Hash"] = std::to_string(hashTableSizeInMegaBytes);
-        Threads.main()->pvCallback = [this](Move move, int depth, int selDepth, Value v) { OnMove(move, depth, selDepth, v); };
-
-        states = StateListPtr(new std::deque<StateInfo>(1));
+        Threads.main()->results.subscriber = [this](const Search::PVRecord& r) { OnResult(r); };
+        bestMoves.reserve(maxMoveCount);
+        searchMoves.reserve(maxMoveCount);
+        fenGame.SetPosition(StartFEN);
+        SetRoot(fenGame.GetPosition());
         return true;
     }
 
@@ -86,94 +400,135 @@ public:
         return true;
     }
 
+    bool SetAnalysisFile(const String& path) final {
+        std::lock_guard<std::mutex> guard(g_thinkLock);
+        StopPonderSearch();
+        Options["Analysis File"] = std::string(path.c_str());
+        return analysisdb.enabled();
+    }
+
+    void SetMultiPVReduction(int percent) final {
+        std::lock_guard<std::mutex> guard(g_thinkLock);
+        StopPonderSearch();
+        Options["MultiPV Reduction"] = std::to_string(std::clamp(percent, 0, 90));
+    }
+
     inline std::string BoolToString(bool b) {
         return b ? "true" : "false";
     }
 
-    int GenerateMoves(const String& fenString, int minTime, int maxTime, int elo, bool useOpeningBook) final {
+    void SetGameMemory(bool enabled) final {
         std::lock_guard<std::mutex> guard(g_thinkLock);
-        Options["Minimum Thinking Time"] = std::to_string(minTime);
-        Options["UCI_LimitStrength"] = BoolToString(true);
-        Options["UCI_Elo"] = std::to_string(elo);
-        Options["Skill Level"] = std::to_string(20); // disabled
-        Options["Contempt"] = std::to_string(24);    // default
-        Options["OwnBook"] = BoolToString(useOpeningBook);
-        position.set(fenString.c_str(), false, &states->back(), Threads.main());
-        // Get next move
-        Search::LimitsType limits;
-        limits.startTime = now();
-        limits.movetime = maxTime;
+        gameMemory = enabled;
+    }
 
-        g_bestMoves.clear();
-        StateListPtr new_states(new std::deque<StateInfo>(0));
-        new_states->push_back(states->back());
-        limits.startTime = now();
-        Threads.start_thinking(position, new_states, limits, false);
-        Threads.main()->wait_for_search_finished();
+    ChessGame* CreateGame() final {
+        auto game = new StockfishChessGame();
+        game->SetPosition(StartFEN);
+        return game;
+    }
 
-        bestMoves.clear();
+    int GenerateMoves(const String& fenString, int minTime, int maxTime, int elo, bool useOpeningBook) final {
+        StateInfo st;
+        Position pos;
+        pos.set(fenString.c_str(), false, &st, Threads.main());
+        Key key = ResultCache::RequestKey(pos, {0, minTime, maxTime, elo, useOpeningBook});
+        return Request(pos, fenGame.GetPriority(), maxTime, key, true, [&](int budget) {
+            fenGame.SetPosition(fenString);
+            return Generate(fenGame, std::min(minTime, budget), budget, elo, useOpeningBook);
+        });
+    }
 
-        int returnValue = -1;
-        if (g_bestMoves.size()) {
-            for (auto& pair : g_bestMoves) {
-                if (std::find(bestMoves.begin(), bestMoves.end(), pair.second) != bestMoves.end()) {
-                    continue;
-                }
-                bestMoves.push_back(pair.second);
-            }
-            returnValue = (int)bestMoves.size();
-        } else if (useOpeningBook && Threads.main()->rootMoves.size()) {
-            bestMoves.push_back({Threads.main()->rootMoves[0].pv[0], 0, 0, 0.0f});
-        }
+    int GenerateMovesWithSkill(const String& fenString, int minTime, int maxTime, int skill, int maxDepth, int contempt, bool useOpeningBook) final {
+        StateInfo st;
+        Position pos;
+        pos.set(fenString.c_str(), false, &st, Threads.main());
+        Key key = ResultCache::RequestKey(pos, {1, minTime, maxTime, skill, maxDepth, contempt, useOpeningBook});
+        return Request(pos, fenGame.GetPriority(), maxTime, key, true, [&](int budget) {
+            fenGame.SetPosition(fenString);
+            return GenerateWithSkill(fenGame, std::min(minTime, budget), budget, skill, maxDepth, contempt, useOpeningBook);
+        });
+    }
 
-        std::reverse(bestMoves.begin(), bestMoves.end());
+    int GenerateMoves(const ChessGame& game, int minTime, int maxTime, int elo, bool useOpeningBook) final {
+        auto& g = static_cast<const StockfishChessGame&>(game);
+        Key key = ResultCache::RequestKey(g.GetPosition(), {0, minTime, maxTime, elo, useOpeningBook});
+        return Request(g.GetPosition(), g.GetPriority(), maxTime, key, !gameMemory, [&](int budget) {
+            return Generate(g, std::min(minTime, budget), budget, elo, useOpeningBook);
+        });
+    }
 
-        return returnValue;
+    int GenerateMovesWithSkill(const ChessGame& game, int minTime, int maxTime, int skill, int maxDepth, int contempt, bool useOpeningBook) final {
+        auto& g = static_cast<const StockfishChessGame&>(game);
+        Key key = ResultCache::RequestKey(g.GetPosition(), {1, minTime, maxTime, skill, maxDepth, contempt, useOpeningBook});
+        return Request(g.GetPosition(), g.GetPriority(), maxTime, key, !gameMemory, [&](int budget) {
+            return GenerateWithSkill(g, std::min(minTime, budget), budget, skill, maxDepth, contempt, useOpeningBook);
+        });
     }
 
-    int GenerateMovesWithSkill(const String& fenString, int minTime, int maxTime, int skill, int maxDepth, int contempt, bool useOpeningBook) final {
-        std::lock_guard<std::mutex> guard(g_thinkLock);
-        Options["Minimum Thinking Time"] = std::to_string(minTime);
-        Options["UCI_LimitStrength"] = BoolToString(false);
-        Options["UCI_Elo"] = std::to_string(1350);
-        Options["Skill Level"] = std::to_string(skill);
-        Options["Contempt"] = std::to_string(contempt);
-        Options["OwnBook"] = BoolToString(useOpeningBook);
-        position.set(fenString.c_str(), false, &states->back(), Threads.main());
-        // Get next move
-        Search::LimitsType limits;
-        limits.startTime = now();
-        limits.depth = maxDepth;
-        limits.movetime = maxTime;
+    void SetQueueLimit(int maxQueued) final {
+        queue.SetLimit(maxQueued);
+    }
 
-        g_bestMoves.clear();
-        StateListPtr new_states(new std::deque<StateInfo>(0));
-        new_states->push_back(states->back());
-        limits.startTime = now();
-        Threads.start_thinking(position, new_states, limits, false);
-        Threads.main()->wait_for_search_finished();
+    String GetQueueStats() const final {
+        auto report = queue.Stats();
+        return String(report.c_str(), report.length());
+    }
 
-        bestMoves.clear();
+    void SetResultCache(int maxEntries, int reusePercent) final {
+        cache.SetSize(maxEntries, reusePercent);
+    }
 
-        int returnValue = -1;
-        if (g_bestMoves.size()) {
-            for (auto& pair : g_bestMoves) {
-                if (std::find(bestMoves.begin(), bestMoves.end(), pair.second) != bestMoves.end()) {
-                    continue;
-                }
-                bestMoves.push_back(pair.second);
-            }
-            returnValue = (int)bestMoves.size();
-        } else if (useOpeningBook && Threads.main()->rootMoves.size()) {
-            bestMoves.push_back({Threads.main()->rootMoves[0].pv[0], 0, 0, 0.0f});
+    bool Ponder() final {
+        std::lock_guard<std::mutex> guard(g_thinkLock);
+        StopPonderSearch();
+        std::lock_guard<std::mutex> result(g_resultLock);
+        if (bestMoves.empty() || !MoveList<LEGAL>(position).contains(bestMoves[0].move)) {
+            return false;
+        }
+        // Without a PV reply fall back to the one stored in the TT
+        Search::RootMove& rm = Threads.main()->rootMoves[0];
+        if (!bestMoves[0].ponder && rm.pv[0] == bestMoves[0].move && (rm.pv.size() > 1 || rm.extract_ponder_from_tt(position))) {
+            bestMoves[0].ponder = rm.pv[1];
         }
+        ponderMove = bestMoves[0].ponder;
+
+        StateListPtr ponderStates = CopyStates(position);
+        Position pos;
+        pos.set(position, &ponderStates->back(), Threads.main());
+        ponderStates->emplace_back();
+        pos.do_move(bestMoves[0].move, ponderStates->back());
+        if (!ponderMove || !MoveList<LEGAL>(pos).contains(ponderMove)) {
+            return false;
+        }
+        ponderStates->emplace_back();
+        pos.do_move(ponderMove, ponderStates->back());
 
-        std::reverse(bestMoves.begin(), bestMoves.end());
+        ponderKey = pos.key();
+        pondering = true;
+        bestMoves.clear();
+        searchMoves.clear();
+        Search::LimitsType limits = lastLimits;
+        limits.startTime = now();
+        Threads.start_thinking(pos, ponderStates, limits, true);
+        return true;
+    }
 
-        return returnValue;
+    String GetPonderMove() const final {
+        std::lock_guard<std::mutex> result(g_resultLock);
+        if (!pondering) {
+            return {};
+        }
+        auto moveString = UCI::move(ponderMove, position.is_chess960());
+        return String(moveString.c_str(), moveString.length());
     }
 
+    void StopPondering() final {
+        std::lock_guard<std::mutex> guard(g_thinkLock);
+        StopPonderSearch();
+    }
     String GetMove(int index) const final {
+        std::lock_guard<std::mutex> result(g_resultLock);
         if (index >= bestMoves.size()) {
             return {};
         }
@@ -182,6 +537,7 @@ public:
     }
 
     float GetMoveScore(int index) const final {
+        std::lock_guard<std::mutex> result(g_resultLock);
         if (index >= bestMoves.size()) {
             return 0.0f;
         }
@@ -189,6 +545,7 @@ public:
     }
 
     int GetMoveDepth(int index) const final {
+        std::lock_guard<std::mutex> result(g_resultLock);
         if (index >= bestMoves.size()) {
             return 0;
         }
@@ -196,16 +553,184 @@ public:
     }
 
     int GetMoveCompletedDepth(int index) const final {
+        std::lock_guard<std::mutex> result(g_resultLock);
         if (index >= bestMoves.size()) {
             return 0;
         }
         return bestMoves[index].selDepth;
     }
 
+    String GetSearchStats() const final {
+        auto report = Search::stats_report(Threads.stats());
+        return String(report.c_str(), report.length());
+    }
+
 private:
+    // Serves a move request: from the cache when it may, otherwise it waits for
+    // its turn in the queue and calls generate with the move time granted.
+    // A position with a repetition in its history is not cached, as the same key
+    // may come without it. A cache hit waits for no running search.
+    template<typename F>
+    int Request(const Position& pos, int tier, int maxTime, Key key, bool cacheable, F generate) {
+        int count;
+        // A negative move time answers at once, as the search always did, and
+        // gives the queue a valid range of budgets. 0 stays "no time limit".
+        if (maxTime < 0) {
+            maxTime = 1;
+        }
+        cacheable = cacheable && !pos.has_repeated();
+        if (cacheable && ReuseResult(pos, key, count)) {
+            return count;
+        }
+        ThinkTurn turn(queue, tier, maxTime);
+        if (!turn.admitted) {
+            return Rejected;
+        }
+        std::lock_guard<std::mutex> guard(g_thinkLock);
+        count = generate(turn.request.budget);
+        if (cacheable && count > 0 && turn.request.budget == maxTime) {
+            std::lock_guard<std::mutex> result(g_resultLock);
+            cache.Store(key, bestMoves, count);
+        }
+        return count;
+    }
+
+    // Answers with the cached moves, as if just searched from pos. A ponder
+    // search on pos is not dropped for it: it goes on as the normal search.
+    // While another request searches there is no ponder search to settle, so
+    // the moves are handed over at once.
+    bool ReuseResult(const Position& pos, Key key, int& count) {
+        std::vector<MoveInfo> moves;
+        if (!cache.Find(key, moves, count)) {
+            return false;
+        }
+        std::unique_lock<std::mutex> guard(g_thinkLock, std::try_to_lock);
+        if (guard.owns_lock()) {
+            if (pondering && pos.key() == ponderKey) {
+                return false;
+            }
+            StopPonderSearch();
+        }
+        std::lock_guard<std::mutex> result(g_resultLock);
+        SetRoot(pos);
+        bestMoves = moves;
+        return true;
+    }
+
+    int Generate(const StockfishChessGame& game, int minTime, int maxTime, int elo, bool useOpeningBook) {
+        if (PonderHit(game.GetPosition())) {
+            return CollectMoves(game, useOpeningBook);
+        }
+        Options["Minimum Thinking Time"] = std::to_string(minTime);
+        Options["UCI_LimitStrength"] = BoolToString(true);
+        Options["UCI_Elo"] = std::to_string(elo);
+        Options["Skill Level"] = std::to_string(20); // disabled
+        Options["Contempt"] = std::to_string(24);    // default
+        Options["OwnBook"] = BoolToString(useOpeningBook);
+        // Get next move
+        Search::LimitsType limits;
+        limits.movetime = maxTime;
+        return Think(game, limits, useOpeningBook);
+    }
+
+    int GenerateWithSkill(const StockfishChessGame& game, int minTime, int maxTime, int skill, int maxDepth, int contempt, bool useOpeningBook) {
+        if (PonderHit(game.GetPosition())) {
+            return CollectMoves(game, useOpeningBook);
+        }
+        Options["Minimum Thinking Time"] = std::to_string(minTime);
+        Options["UCI_LimitStrength"] = BoolToString(false);
+        Options["UCI_Elo"] = std::to_string(1350);
+        Options["Skill Level"] = std::to_string(skill);
+        Options["Contempt"] = std::to_string(contempt);
+        Options["OwnBook"] = BoolToString(useOpeningBook);
+        // Get next move
+        Search::LimitsType limits;
+        limits.depth = maxDepth;
+        limits.movetime = maxTime;
+        return Think(game, limits, useOpeningBook);
+    }
+
+    // Keeps a copy of the position of the moves handed over, with its history,
+    // for pondering. Called with g_resultLock held.
+    void SetRoot(const Position& pos) {
+        states = CopyStates(pos);
+        position.set(pos, &states->back(), Threads.main());
+    }
+
+    // Runs a search on the current position of the game and collects the ranked moves
+    int Think(const StockfishChessGame& game, Search::LimitsType& limits, bool useOpeningBook) {
+        searchMoves.clear();
+        lastLimits = limits;
+        if (UseMemory(game)) {
+            game.Restore(limits);
+        }
+        StateListPtr new_states = CopyStates(game.GetPosition());
+        Position root;
+        root.set(game.GetPosition(), &new_states->back(), Threads.main());
+        limits.startTime = now();
+        Threads.start_thinking(root, new_states, limits, false);
+        return CollectMoves(game, useOpeningBook);
+    }
+
+    // Waits for the search and hands its moves over to the caller
+    int CollectMoves(const StockfishChessGame& game, bool useOpeningBook) {
+        Threads.main()->wait_for_search_finished();
+
+        if (UseMemory(game) && searchMoves.size()) {
+            game.Store(bestLine);
+        }
+
+        std::lock_guard<std::mutex> result(g_resultLock);
+        SetRoot(game.GetPosition());
+        bestMoves = searchMoves;
+
+        int returnValue = -1;
+        if (bestMoves.size()) {
+            returnValue = (int)bestMoves.size();
+        } else if (useOpeningBook && Threads.main()->rootMoves.size()) {
+            bestMoves.push_back({Threads.main()->rootMoves[0].pv[0], MOVE_NONE, 0, 0, 0.0f});
+        }
+
+        return returnValue;
+    }
+
+    bool UseMemory(const StockfishChessGame& game) const {
+        return gameMemory && &game != &fenGame;
+    }
+
+    // Settles a running ponder search against the position just set: when it is
+    // the expected one the search goes on as a normal one, otherwise it is dropped.
+    bool PonderHit(const Position& pos) {
+        if (!pondering || pos.key() != ponderKey) {
+            StopPonderSearch();
+            return false;
+        }
+        pondering = false;
+        Threads.main()->ponder = false; // Switch to normal search
+        return true;
+    }
+
+    void StopPonderSearch() {
+        if (pondering) {
+            pondering = false;
+            Threads.stop = true;
+            Threads.main()->wait_for_search_finished();
+        }
+    }
+
+    ThinkQueue queue;
+    ResultCache cache;
+    StockfishChessGame fenGame; // Game of the calls taking a FEN string
     StateListPtr states;
     Position position;
-    std::vector<MoveInfo> bestMoves;
+    std::vector<MoveInfo> bestMoves;   // Handed to the caller
+    std::vector<MoveInfo> searchMoves; // Reported by the running search
+    Search::PVRecord bestLine; // Latest first line
+    Search::LimitsType lastLimits;
+    Move ponderMove = MOVE_NONE;
+    Key ponderKey = 0;
+    bool pondering = false;
+    std::atomic<bool> gameMemory{false}; // Read unlocked by Request()
 };
 
 // ChessEngine
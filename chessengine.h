@@ -4,6 +4,23 @@
 
 namespace ChessNetwork {
 
+// ChessGame keeps the position and the move history of one game, so that the
+// engine sees earlier positions for repetitions and moves are sent one by one.
+// Moves are in UCI notation (e2e4, e7e8q).
+class ChessGame {
+public:
+    virtual ~ChessGame() {
+    }
+    virtual void SetPosition(const String& fenString) = 0;
+    virtual bool PushMove(const String& move) = 0;
+    virtual bool PopMove() = 0;
+    virtual String GetFen() const = 0;
+
+    // Move requests of lower tiers are served first, 0 being the most urgent;
+    // games start at tier 1, as do the calls taking a FEN string.
+    virtual void SetPriority(int tier) = 0;
+};
+
 // ChessEngine
 class ChessEngine {
 public:
@@ -13,12 +30,64 @@ public:
     }
     virtual bool Initialize(int hashTableSizeInMegaBytes, int maxMoveCount) = 0;
     virtual bool SetOpeningBook(char* openingBookBinary, int openingBookBinarySize) = 0;
+    // Maps an analysis file written by the engine's "buildbook" command. Full
+    // strength searches (skill 20) of a position found in it at the asked depth
+    // or deeper return the stored moves and scores at once. An empty path
+    // closes it. Returns false if no file is in use afterwards.
+    virtual bool SetAnalysisFile(const String& path) = 0;
+    // Searches the moves after the best one at a depth reduced by this percentage
+    // (0 to 90), which ranks them at a fraction of the cost, with the depth and
+    // score of that shallower search. The best move is searched at full depth.
+    // 0, the default, searches all of them at full depth.
+    virtual void SetMultiPVReduction(int percent) = 0;
     virtual int GenerateMoves(const String& fenString, int minTime, int maxTime, int elo, bool useOpeningBook) = 0;
     virtual int GenerateMovesWithSkill(const String& fenString, int minTime, int maxTime, int skill, int maxDepth, int contempt, bool useOpeningBook) = 0;
+
+    // Games are created after Initialize and deleted by the caller. With game memory
+    // on, each game keeps the move ordering histories and the PV of its last search
+    // to seed the next one, at a cost of about 8 MB per game.
+    virtual ChessGame* CreateGame() = 0;
+    virtual void SetGameMemory(bool enabled) = 0;
+    virtual int GenerateMoves(const ChessGame& game, int minTime, int maxTime, int elo, bool useOpeningBook) = 0;
+    virtual int GenerateMovesWithSkill(const ChessGame& game, int minTime, int maxTime, int skill, int maxDepth, int contempt, bool useOpeningBook) = 0;
+
+    // Concurrent GenerateMoves calls search one at a time, ordered by priority
+    // tier, then by deadline: the call time plus maxTime. A call that waited
+    // searches until its deadline, but at least a tenth of maxTime, so that an
+    // overload costs strength rather than response time. With a queue limit,
+    // a call arriving while that many wait is rejected and returns -2, unless
+    // it goes before the last waiting call, which is rejected instead. A limit
+    // of 0, the default, admits all. GetQueueStats() reports the queue depth
+    // and waits.
+    virtual void SetQueueLimit(int maxQueued) = 0;
+    virtual String GetQueueStats() const = 0;
+    // Keeps the moves of the last maxEntries GenerateMoves calls, keyed by the
+    // position and all call parameters. A repeated call returns the kept moves
+    // at once in reusePercent of the cases and searches again otherwise, so that
+    // play stays varied. The key includes the fifty-move counter. Book moves,
+    // games with memory, positions with a repetition in their history and
+    // searches cut short by the queue are not cached. A hit does not wait for
+    // a search running for another call. 0 entries, the default, turns it off.
+    virtual void SetResultCache(int maxEntries, int reusePercent) = 0;
+
     virtual String GetMove(int index) const = 0;
     virtual float GetMoveScore(int index) const = 0;
     virtual int GetMoveDepth(int index) const = 0;
     virtual int GetMoveCompletedDepth(int index) const = 0;
+
+    // Starts a background search on the position expected after the best move of
+    // the last GenerateMoves call and the predicted reply, with the same options
+    // and limits, the move time counting from now. A following GenerateMoves call
+    // on that position takes over the running search instead of starting a new
+    // one; any other call stops it. Returns false if there is nothing to ponder.
+    // GetPonderMove() returns the predicted reply being pondered on.
+    virtual bool Ponder() = 0;
+    virtual String GetPonderMove() const = 0;
+    virtual void StopPondering() = 0;
+
+    // Search counters summed over all threads since Initialize(), one per line.
+    // Only builds with -DSEARCH_STATS count, other builds return a short note.
+    virtual String GetSearchStats() const = 0;
 };
 
 } // namespace ChessNetwork
\ No newline at end of file
@@ -0,0 +1,61 @@
+// Profiling workload for 'make profile-library': a few short games played
+// through the embedding API, the way the app drives the engine. Build it from
+// the src directory with the Makefile, it is not part of the library.
+#include "chessengine.h"
+// std
+#include <cstdio>
+#include <vector>
+
+using namespace ChessNetwork;
+
+namespace {
+
+const char* Openings[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    "rnbqkb1r/pp2pppp/3p1n2/8/3NP3/8/PPP2PPP/RNBQKB1R w KQkq - 1 5",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+
+const int Plies = 16;
+
+} // namespace
+
+int main() {
+    pBase->Initialize();
+    auto ce = ChessEngine::Create();
+    ce->Initialize(16, 4);
+    ce->SetGameMemory(true);
+
+    std::vector<ChessGame*> games;
+    for (auto fen : Openings) {
+        games.push_back(ce->CreateGame());
+        games.back()->SetPosition(fen);
+    }
+
+    // Games are interleaved like concurrent players, the first one also ponders
+    for (int ply = 0; ply < Plies; ++ply) {
+        for (size_t i = 0; i < games.size(); ++i) {
+            auto& game = *games[i];
+            auto count = i % 2 ? ce->GenerateMovesWithSkill(game, 0, 50, 5 + ply % 15, 12, 24, false)
+                               : ce->GenerateMoves(game, 0, 50, 1200 + 100 * ply, false);
+            if (count <= 0 || !game.PushMove(ce->GetMove(0))) {
+                continue;
+            }
+            if (i == 0 && ce->Ponder() && game.PushMove(ce->GetPonderMove())) {
+                ce->GenerateMoves(game, 0, 50, 2500, false);
+                game.PushMove(ce->GetMove(0));
+            }
+        }
+        auto count = ce->GenerateMoves(games[ply % games.size()]->GetFen(), 0, 20, 2000, false);
+        printf("ply %d: %d moves, best %s\n", ply, count, count > 0 ? ce->GetMove(0).c_str() : "-");
+    }
+
+    ce->StopPondering();
+    for (auto game : games) {
+        delete game;
+    }
+    delete ce;
+    return 0;
+}
@@ -0,0 +1,233 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2020 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "analysisdb.h"
+#include "misc.h"
+#include "position.h"
+#include "uci.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#define WIN32_LEAN_AND_MEAN
+#ifndef NOMINMAX
+#  define NOMINMAX // Disable macros min() and max()
+#endif
+#include <windows.h>
+#endif
+
+AnalysisDB analysisdb; // Global analysis store
+
+namespace {
+
+  // The file starts with a header, padded so that the entries stay aligned
+  struct Header {
+    char magic[8];
+    uint64_t count;
+  };
+
+  constexpr char FileMagic[8] = { 'S', 'F', 'A', 'N', 'A', 'D', 'B', '1' };
+
+  static_assert(sizeof(Header) == 16, "Header size incorrect");
+
+} // namespace
+
+
+/// AnalysisDB::init() maps the given file, replacing the one in use, if any.
+/// An empty path or "<empty>" just closes the store. A file that cannot be
+/// mapped, or is not a valid analysis file, is reported and leaves it closed.
+
+void AnalysisDB::init(const std::string& path) {
+
+  close();
+
+  if (path.empty() || path == "<empty>")
+      return;
+
+#ifndef _WIN32
+  int fd = ::open(path.c_str(), O_RDONLY);
+  struct stat statbuf;
+
+  if (fd != -1 && !fstat(fd, &statbuf) && statbuf.st_size > 0)
+  {
+      mappedSize = size_t(statbuf.st_size);
+      mapping = mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+#if defined(MADV_RANDOM)
+      if (mapping != MAP_FAILED)
+          madvise(mapping, mappedSize, MADV_RANDOM);
+#endif
+      if (mapping == MAP_FAILED)
+          mapping = nullptr;
+  }
+
+  if (fd != -1)
+      ::close(fd);
+#else
+  HANDLE fd = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                         OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+
+  if (fd != INVALID_HANDLE_VALUE)
+  {
+      DWORD sizeHigh;
+      DWORD sizeLow = GetFileSize(fd, &sizeHigh);
+      mappedSize = (size_t(sizeHigh) << 32) | sizeLow;
+      mapHandle = mappedSize ? CreateFileMapping(fd, nullptr, PAGE_READONLY, sizeHigh, sizeLow, nullptr) : nullptr;
+      mapping = mapHandle ? MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+      CloseHandle(fd);
+  }
+#endif
+
+  if (!mapping)
+  {
+      sync_cout << "info string Could not map analysis file " << path << sync_endl;
+      close();
+      return;
+  }
+
+  const Header* header = static_cast<const Header*>(mapping);
+
+  // The entry count is checked against the file size by division, not to be
+  // fooled by a product overflowing.
+  if (   mappedSize < sizeof(Header)
+      || memcmp(header->magic, FileMagic, sizeof(FileMagic))
+      || (mappedSize - sizeof(Header)) % sizeof(AnalysisEntry)
+      || header->count != (mappedSize - sizeof(Header)) / sizeof(AnalysisEntry))
+  {
+      sync_cout << "info string Invalid analysis file " << path << sync_endl;
+      close();
+      return;
+  }
+
+  entries = reinterpret_cast<const AnalysisEntry*>(header + 1);
+  count = size_t(header->count);
+
+  sync_cout << "info string Analysis file " << path << " with " << count << " positions" << sync_endl;
+}
+
+
+/// AnalysisDB::close() unmaps the file in use, if any
+
+void AnalysisDB::close() {
+
+  if (mapping)
+  {
+#ifndef _WIN32
+      munmap(mapping, mappedSize);
+#else
+      UnmapViewOfFile(mapping);
+#endif
+  }
+
+#ifdef _WIN32
+  if (mapHandle)
+      CloseHandle(mapHandle);
+
+  mapHandle = nullptr;
+#endif
+
+  entries = nullptr;
+  count = mappedSize = 0;
+  mapping = nullptr;
+}
+
+
+/// AnalysisDB::probe() looks up the position. When it is stored at minDepth or
+/// deeper, the root moves are cut down to the stored lines, ranked and scored
+/// as if just searched, and the depth of the first line is returned. Returns 0,
+/// leaving the root moves as they are, when there is nothing usable.
+
+Depth AnalysisDB::probe(const Position& pos, Search::RootMoves& rootMoves, Depth minDepth) const {
+
+  if (!count)
+      return 0;
+
+  const AnalysisEntry* e = std::lower_bound(entries, entries + count, pos.key(),
+                           [](const AnalysisEntry& a, Key k) { return a.key < k; });
+
+  if (e == entries + count || e->key != pos.key() || e->depth[0] < std::max(minDepth, 1))
+      return 0;
+
+  // All the stored moves must be among the root moves, each once, which also
+  // rules out a stale or corrupt entry or, unlikely, a key collision.
+  size_t n = 0;
+
+  for ( ; n < AnalysisEntry::MaxLines && e->move[n]; ++n)
+      if (   std::find(rootMoves.begin(), rootMoves.end(), Move(e->move[n])) == rootMoves.end()
+          || std::find(e->move, e->move + n, e->move[n]) != e->move + n)
+          return 0;
+
+  if (!n)
+      return 0;
+
+  for (size_t i = 0; i < n; ++i)
+  {
+      auto rm = std::find(rootMoves.begin() + i, rootMoves.end(), Move(e->move[i]));
+      std::swap(rootMoves[i], *rm);
+      rootMoves[i].score = rootMoves[i].previousScore = Value(e->score[i]);
+      rootMoves[i].selDepth = e->depth[i];
+  }
+
+  rootMoves.erase(rootMoves.begin() + n, rootMoves.end());
+  return e->depth[0];
+}
+
+
+/// AnalysisDB::write() writes an analysis file from the given entries, keeping
+/// the deepest analysis of a position met twice. It is written to a temporary
+/// file first and then renamed, so a mapped file of the same name stays valid.
+
+bool AnalysisDB::write(const std::string& path, std::vector<AnalysisEntry> entries) {
+
+  std::sort(entries.begin(), entries.end(), [](const AnalysisEntry& a, const AnalysisEntry& b) {
+      return a.key != b.key ? a.key < b.key : a.depth[0] > b.depth[0];
+  });
+  entries.erase(std::unique(entries.begin(), entries.end(), [](const AnalysisEntry& a, const AnalysisEntry& b) {
+      return a.key == b.key;
+  }), entries.end());
+
+  Header header;
+  memcpy(header.magic, FileMagic, sizeof(FileMagic));
+  header.count = entries.size();
+
+  std::string tmp = path + ".tmp";
+  std::ofstream out(tmp, std::ios::binary);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(entries.data()), std::streamsize(entries.size() * sizeof(AnalysisEntry)));
+  out.close();
+
+#ifdef _WIN32
+  std::remove(path.c_str()); // No replacing rename on Windows
+#endif
+
+  if (!out || std::rename(tmp.c_str(), path.c_str()))
+  {
+      std::remove(tmp.c_str());
+      return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,76 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2020 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ANALYSISDB_H_INCLUDED
+#define ANALYSISDB_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "search.h"
+#include "types.h"
+
+/// AnalysisEntry holds the best lines of a position analyzed in advance, ranked,
+/// with their scores and depths. Unused lines have a null move. Entries are
+/// stored in the file sorted by key, in native byte order.
+
+struct AnalysisEntry {
+
+  static constexpr int MaxLines = 4;
+
+  Key key;
+  uint16_t move[MaxLines];
+  int16_t score[MaxLines];
+  uint8_t depth[MaxLines];
+  uint8_t padding[4];
+};
+
+static_assert(sizeof(AnalysisEntry) == 32, "AnalysisEntry size incorrect");
+
+
+/// AnalysisDB class is a read-only store of deep analysis, mapped into memory
+/// from a file written by AnalysisDB::write(). Unlike an opening book it keeps
+/// scored lines, so a position found in it is answered as if just searched.
+
+class AnalysisDB {
+
+public:
+  ~AnalysisDB() { close(); }
+
+  void init(const std::string& path);
+  bool enabled() const { return count > 0; }
+  size_t size() const { return count; }
+  Depth probe(const Position& pos, Search::RootMoves& rootMoves, Depth minDepth) const;
+
+  static bool write(const std::string& path, std::vector<AnalysisEntry> entries);
+
+private:
+  void close();
+
+  const AnalysisEntry* entries = nullptr;
+  size_t count = 0;
+  void* mapping = nullptr; // Base address of the mapped file
+  size_t mappedSize = 0;
+#ifdef _WIN32
+  void* mapHandle = nullptr;
+#endif
+};
+
+extern AnalysisDB analysisdb;
+
+#endif // #ifndef ANALYSISDB_H_INCLUDED
@@ -18,6 +18,7 @@
 
 #include <algorithm>
 #include <bitset>
+#include <chrono>
 
 #include "bitboard.h"
 #include "misc.h"
@@ -32,13 +33,25 @@ Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
 
 Magic RookMagics[SQUARE_NB];
 Magic BishopMagics[SQUARE_NB];
+bool UsePext;
 
 namespace {
 
+#if defined(COMPACT_ATTACKS)
+  Bitboard RookTable[4900];         // To store the distinct rook attacks
+  Bitboard BishopTable[1428];       // To store the distinct bishop attacks
+  uint8_t  RookIndex[0x19000];      // To select rook attacks in RookTable
+  uint8_t  BishopIndex[0x1480];     // To select bishop attacks in BishopTable
+
+  void init_magics(PieceType pt, Bitboard table[], uint8_t indexTable[], Magic magics[]);
+#else
   Bitboard RookTable[0x19000];  // To store rook attacks
   Bitboard BishopTable[0x1480]; // To store bishop attacks
 
   void init_magics(PieceType pt, Bitboard table[], Magic magics[]);
+#endif
+  void set_sliders(bool usePext);
+  int64_t time_sliders();
 
 }
 
@@ -87,8 +100,7 @@ void Bitboards::init() {
       for (Square s2 = SQ_A1; s2 <= SQ_H8; ++s2)
           SquareDistance[s1][s2] = std::max(distance<File>(s1, s2), distance<Rank>(s1, s2));
 
-  init_magics(ROOK, RookTable, RookMagics);
-  init_magics(BISHOP, BishopTable, BishopMagics);
+  init_sliders("Auto");
 
   for (Square s1 = SQ_A1; s1 <= SQ_H8; ++s1)
   {
@@ -112,6 +124,34 @@ void Bitboards::init() {
 }
 
 
+/// Bitboards::init_sliders() sets up the slider attack tables for the given
+/// backend and returns the one in use: "Magic" for fancy magics, or "Pext" in
+/// builds with pext support. "Auto" times both and keeps the faster one.
+
+std::string Bitboards::init_sliders(const std::string& mode) {
+
+  bool usePext = HasPext && mode != "Magic";
+
+  if (HasPext && mode == "Auto")
+  {
+      int64_t magicTime = INT64_MAX, pextTime = INT64_MAX;
+
+      for (int i = 0; i < 2; ++i)
+      {
+          set_sliders(false);
+          magicTime = std::min(magicTime, time_sliders());
+          set_sliders(true);
+          pextTime = std::min(pextTime, time_sliders());
+      }
+      usePext = pextTime < magicTime;
+  }
+
+  set_sliders(usePext);
+
+  return usePext ? "Pext" : "Magic";
+}
+
+
 namespace {
 
   Bitboard sliding_attack(PieceType pt, Square sq, Bitboard occupied) {
@@ -136,7 +176,11 @@ namespace {
   // www.chessprogramming.org/Magic_Bitboards. In particular, here we use the so
   // called "fancy" approach.
 
+#if defined(COMPACT_ATTACKS)
+  void init_magics(PieceType pt, Bitboard table[], uint8_t indexTable[], Magic magics[]) {
+#else
   void init_magics(PieceType pt, Bitboard table[], Magic magics[]) {
+#endif
 
     // Optimal PRNG seeds to pick the correct magics in the shortest time
     int seeds[][RANK_NB] = { { 8977, 44560, 54343, 38998,  5731, 95205, 104912, 17020 },
@@ -145,6 +189,11 @@ namespace {
     Bitboard occupancy[4096], reference[4096], edges, b;
     int epoch[4096] = {}, cnt = 0, size = 0;
 
+#if defined(COMPACT_ATTACKS)
+    Bitboard scratch[4096];
+    int distinct = 0;
+#endif
+
     for (Square s = SQ_A1; s <= SQ_H8; ++s)
     {
         // Board edges are not considered in the relevant occupancies
@@ -160,8 +209,16 @@ namespace {
         m.shift = (Is64Bit ? 64 : 32) - popcount(m.mask);
 
         // Set the offset for the attacks table of the square. We have individual
-        // table sizes for each square with "Fancy Magic Bitboards".
+        // table sizes for each square with "Fancy Magic Bitboards". Compact tables
+        // are built in a scratch table first, see below.
+#if defined(COMPACT_ATTACKS)
+        m.attackIndex = s == SQ_A1 ? indexTable : magics[s - 1].attackIndex + size;
+        m.attacks = s == SQ_A1 ? table : magics[s - 1].attacks + distinct;
+        Bitboard* attacks = scratch;
+#else
         m.attacks = s == SQ_A1 ? table : magics[s - 1].attacks + size;
+        Bitboard* attacks = m.attacks;
+#endif
 
         // Use Carry-Rippler trick to enumerate all subsets of masks[s] and
         // store the corresponding sliding attack bitboard in reference[].
@@ -170,21 +227,24 @@ namespace {
             occupancy[size] = b;
             reference[size] = sliding_attack(pt, s, b);
 
-            if (HasPext)
-                m.attacks[pext(b, m.mask)] = reference[size];
+            if (UsePext)
+                attacks[pext(b, m.mask)] = reference[size];
 
             size++;
             b = (b - m.mask) & m.mask;
         } while (b);
 
-        if (HasPext)
-            continue;
+        // Magics are searched only once, later calls just refill the table
+        if (!UsePext && m.magic)
+            for (int i = 0; i < size; ++i)
+                attacks[m.index(occupancy[i])] = reference[i];
 
         PRNG rng(seeds[Is64Bit][rank_of(s)]);
 
         // Find a magic for square 's' picking up an (almost) random number
-        // until we find the one that passes the verification test.
-        for (int i = 0; i < size; )
+        // until we find the one that passes the verification test. There is
+        // nothing to search with pext, or when the magic is already known.
+        for (int i = UsePext || m.magic ? size : 0; i < size; )
         {
             for (m.magic = 0; popcount((m.magic * m.mask) >> 56) < 6; )
                 m.magic = rng.sparse_rand<Bitboard>();
@@ -202,12 +262,66 @@ namespace {
                 if (epoch[idx] < cnt)
                 {
                     epoch[idx] = cnt;
-                    m.attacks[idx] = reference[i];
+                    attacks[idx] = reference[i];
                 }
-                else if (m.attacks[idx] != reference[i])
+                else if (attacks[idx] != reference[i])
                     break;
             }
         }
+
+#if defined(COMPACT_ATTACKS)
+        // Keep each distinct attack set of the square once, at most 144 for a
+        // rook, and store for every index the byte that selects it.
+        for (distinct = 0, b = 0; b < Bitboard(size); ++b)
+        {
+            Bitboard* a = std::find(m.attacks, m.attacks + distinct, reference[b]);
+
+            if (a == m.attacks + distinct)
+                m.attacks[distinct++] = reference[b];
+
+            m.attackIndex[m.index(occupancy[b])] = uint8_t(a - m.attacks);
+        }
+#endif
     }
   }
+
+
+  // set_sliders() fills the rook and bishop attack tables for pext or magic indexing
+
+  void set_sliders(bool usePext) {
+
+    UsePext = usePext;
+
+#if defined(COMPACT_ATTACKS)
+    init_magics(ROOK, RookTable, RookIndex, RookMagics);
+    init_magics(BISHOP, BishopTable, BishopIndex, BishopMagics);
+#else
+    init_magics(ROOK, RookTable, RookMagics);
+    init_magics(BISHOP, BishopTable, BishopMagics);
+#endif
+  }
+
+
+  // time_sliders() returns the time in nanoseconds of a fixed batch of queen
+  // attack lookups over random occupancies, used to pick the faster backend.
+
+  int64_t time_sliders() {
+
+    PRNG rng(1070372);
+    Bitboard occupied[256], sum = 0;
+
+    for (Bitboard& b : occupied)
+        b = rng.rand<Bitboard>() & rng.rand<Bitboard>();
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < 4096; ++i)
+        for (Square s = SQ_A1; s <= SQ_H8; ++s)
+            sum += attacks_bb<QUEEN>(s, occupied[(i + s) & 255] ^ (sum & 1));
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    // Add the (zero or one) low bit of the sum, so the lookups are not optimized away
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() + int64_t(sum & 1);
+  }
 }
@@ -33,6 +33,7 @@ bool probe(Square wksq, Square wpsq, Square bksq, Color us);
 namespace Bitboards {
 
 void init();
+std::string init_sliders(const std::string& mode);
 const std::string pretty(Bitboard b);
 
 }
@@ -78,17 +79,27 @@ extern Bitboard PseudoAttacks[PIECE_TYPE_NB][SQUARE_NB];
 extern Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
 
 
-/// Magic holds all magic bitboards relevant data for a single square
+/// UsePext is set when the slider tables are laid out for pext indexing. Builds
+/// with pext support can still use magics, as pext is very slow on some CPUs.
+extern bool UsePext;
+
+/// Magic holds all magic bitboards relevant data for a single square. With
+/// compact tables the index selects a byte in attackIndex, which in turn selects
+/// one of the distinct attack sets of the square: about a fifth of the memory
+/// for a second load, which mostly hits the cache.
 struct Magic {
   Bitboard  mask;
   Bitboard  magic;
   Bitboard* attacks;
+#if defined(COMPACT_ATTACKS)
+  uint8_t*  attackIndex;
+#endif
   unsigned  shift;
 
   // Compute the attack's index using the 'magic bitboards' approach
   unsigned index(Bitboard occupied) const {
 
-    if (HasPext)
+    if (HasPext && UsePext)
         return unsigned(pext(occupied, mask));
 
     if (Is64Bit)
@@ -98,6 +109,14 @@ struct Magic {
     unsigned hi = unsigned(occupied >> 32) & unsigned(mask >> 32);
     return (lo * unsigned(magic) ^ hi * unsigned(magic >> 32)) >> shift;
   }
+
+  Bitboard attacks_bb(Bitboard occupied) const {
+#if defined(COMPACT_ATTACKS)
+    return attacks[attackIndex[index(occupied)]];
+#else
+    return attacks[index(occupied)];
+#endif
+  }
 };
 
 extern Magic RookMagics[SQUARE_NB];
@@ -302,8 +321,8 @@ inline Bitboard attacks_bb(Square s, Bitboard occupied) {
 
   switch (Pt)
   {
-  case BISHOP: return BishopMagics[s].attacks[BishopMagics[s].index(occupied)];
-  case ROOK  : return   RookMagics[s].attacks[  RookMagics[s].index(occupied)];
+  case BISHOP: return BishopMagics[s].attacks_bb(occupied);
+  case ROOK  : return   RookMagics[s].attacks_bb(occupied);
   case QUEEN : return attacks_bb<BISHOP>(s, occupied) | attacks_bb<ROOK>(s, occupied);
   default    : return PseudoAttacks[Pt][s];
   }
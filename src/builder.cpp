@@ -0,0 +1,531 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2020 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include "analysisdb.h"
+#include "builder.h"
+#include "misc.h"
+#include "movegen.h"
+#include "polybook.h"
+#include "position.h"
+#include "thread.h"
+#include "uci.h"
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using std::string;
+
+namespace {
+
+  const string StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+  // A position of the tree, with its analysis once searched
+  struct Node {
+    string fen;
+    int ply; // Plies from its seed
+    AnalysisEntry entry;
+  };
+
+
+  // san_to_move() returns the legal move written in Standard Algebraic Notation,
+  // or MOVE_NONE if there is none or the notation is ambiguous.
+
+  Move san_to_move(const Position& pos, string san) {
+
+    san.erase(std::remove_if(san.begin(), san.end(),
+                             [](char c) { return strchr("x=+#!?", c); }), san.end());
+
+    bool castling = san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0";
+    PieceType pt = PAWN, promotion = NO_PIECE_TYPE;
+    size_t idx;
+
+    if (!castling && !san.empty() && (idx = string("NBRQK").find(san[0])) != string::npos)
+        pt = PieceType(KNIGHT + idx), san.erase(0, 1);
+
+    if (!castling && !san.empty() && pt == PAWN && (idx = string("NBRQ").find(san.back())) != string::npos)
+        promotion = PieceType(KNIGHT + idx), san.pop_back();
+
+    if (!castling && san.size() < 2)
+        return MOVE_NONE;
+
+    Move found = MOVE_NONE;
+
+    for (const auto& m : MoveList<LEGAL>(pos))
+    {
+        if (castling)
+        {
+            // Castling is encoded as king captures rook, so kingside goes up
+            if (type_of(m.move) == CASTLING && (to_sq(m) > from_sq(m)) == (san.size() == 3))
+                return m;
+
+            continue;
+        }
+
+        string origin = UCI::square(from_sq(m));
+
+        if (   type_of(m.move) != CASTLING
+            && type_of(pos.moved_piece(m)) == pt
+            && san.compare(san.size() - 2, 2, UCI::square(to_sq(m))) == 0
+            && (type_of(m.move) == PROMOTION ? promotion_type(m) == promotion : promotion == NO_PIECE_TYPE)
+            && std::all_of(san.begin(), san.end() - 2, [&](char c) { return origin.find(c) != string::npos; }))
+        {
+            if (found)
+                return MOVE_NONE;
+
+            found = m;
+        }
+    }
+
+    return found;
+  }
+
+
+  // read_pgn() adds the positions of the main line of each game, starting from
+  // the initial position or the one of the FEN tag. Comments, variations and
+  // annotations are skipped, as is the rest of a game after an unknown move.
+
+  void read_pgn(std::istream& in, std::vector<string>& fens) {
+
+    StateListPtr states;
+    Position pos;
+    string setup = StartFEN;
+    bool started = false, broken = false;
+    char c;
+
+    while (in.get(c))
+    {
+        if (c == '[')
+        {
+            string tag, name;
+            std::getline(in, tag, ']');
+            std::istringstream ss(tag);
+            ss >> name;
+
+            if (started) // Tags of the next game
+                setup = StartFEN, started = false;
+
+            if (name == "FEN")
+            {
+                std::getline(ss >> std::ws, setup);
+                setup.erase(std::remove(setup.begin(), setup.end(), '"'), setup.end());
+            }
+        }
+        else if (c == '{')
+            in.ignore(std::numeric_limits<std::streamsize>::max(), '}');
+
+        else if (c == ';')
+            in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+        else if (c == '(')
+            for (int level = 1; level && in.get(c); )
+                level += (c == '(') - (c == ')');
+
+        else if (!isspace(c))
+        {
+            string token(1, c);
+
+            while (in.get(c) && !isspace(c) && !strchr("[{;(", c))
+                token += c;
+
+            if (in && !isspace(c))
+                in.unget();
+
+            if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*")
+            {
+                setup = StartFEN, started = false;
+                continue;
+            }
+
+            // Drop a move number, as in "12." or "12...e5"
+            if (isdigit(token[0]) && token.find('.') != string::npos)
+                token.erase(0, token.find_last_of('.') + 1);
+
+            if (token.empty() || token[0] == '$' || (started && broken))
+                continue;
+
+            if (!started)
+            {
+                states = StateListPtr(new std::deque<StateInfo>(1));
+                pos.set(setup, Options["UCI_Chess960"], &states->back(), Threads.main());
+                fens.push_back(pos.fen());
+                started = true, broken = false;
+            }
+
+            Move m = san_to_move(pos, token);
+
+            if (!m)
+            {
+                sync_cout << "info string Skipping game from unknown move " << token << sync_endl;
+                broken = true;
+                continue;
+            }
+
+            states->emplace_back();
+            pos.do_move(m, states->back());
+            fens.push_back(pos.fen());
+        }
+    }
+  }
+
+
+  // read_epd() adds the position of each line of a FEN or EPD file
+
+  void read_epd(std::istream& in, std::vector<string>& fens) {
+
+    string line;
+
+    while (std::getline(in, line))
+    {
+        // Keep the four fields that matter to the key, dropping EPD operations
+        std::istringstream ss(line);
+        string field, fen;
+
+        for (int i = 0; i < 4 && ss >> field; ++i)
+            fen += field + " ";
+
+        if (std::count(fen.begin(), fen.end(), ' ') == 4)
+            fens.push_back(fen + "0 1");
+    }
+  }
+
+
+  // analyze() searches the nodes of a level at positions first, first + step,
+  // ... in turn, with the search output muted, and stores their best lines.
+
+  void analyze(std::vector<Node>& nodes, const std::vector<size_t>& level,
+               size_t first, size_t step, Depth depth) {
+
+    Search::PVRecord lines[AnalysisEntry::MaxLines];
+    auto subscriber = Threads.main()->results.subscriber;
+    Threads.main()->results.subscriber = [&](const Search::PVRecord& r) {
+        if (r.multiPV <= AnalysisEntry::MaxLines)
+            lines[r.multiPV - 1] = r;
+    };
+
+    Position pos;
+
+    for (size_t i = first; i < level.size(); i += step)
+    {
+        Node& n = nodes[level[i]];
+        StateListPtr states(new std::deque<StateInfo>(1));
+        pos.set(n.fen, Options["UCI_Chess960"], &states->back(), Threads.main());
+        n.entry = {};
+        n.entry.key = pos.key();
+
+        if (!MoveList<LEGAL>(pos).size())
+            continue;
+
+        for (auto& r : lines)
+            r.pvLength = 0;
+
+        Search::LimitsType limits;
+        limits.depth = depth;
+        limits.startTime = now();
+
+        std::cout.setstate(std::ios::failbit);
+        Threads.start_thinking(pos, states, limits);
+        Threads.main()->wait_for_search_finished();
+        std::cout.clear();
+
+        for (int l = 0; l < AnalysisEntry::MaxLines && lines[l].pvLength; ++l)
+        {
+            n.entry.move[l] = uint16_t(lines[l].move());
+            n.entry.score[l] = int16_t(lines[l].score);
+            n.entry.depth[l] = uint8_t(std::min(lines[l].depth, 255));
+        }
+    }
+
+    Threads.main()->results.subscriber = subscriber;
+  }
+
+
+  // analyze_level() searches the nodes of a level. With more than one job each
+  // job is a forked process with its share of the threads and processors and
+  // its own hash table, taking every jobs-th node and handing back the entries
+  // in a file. Returns false if a job failed.
+
+  bool analyze_level(std::vector<Node>& nodes, const std::vector<size_t>& level, const Builder::Params& p) {
+
+    size_t jobs = std::min(size_t(std::max(p.jobs, 1)), level.size());
+
+#ifndef _WIN32
+    if (jobs > 1)
+    {
+        size_t threads = std::max(size_t(Options["Threads"]) / jobs, size_t(1));
+        std::vector<pid_t> pids;
+        bool ok = true;
+
+        // Only the forking thread lives on in a child, so the pool is stopped here
+        std::cout.flush();
+        Threads.set(0);
+
+        for (size_t k = 0; k < jobs && ok; ++k)
+        {
+            pid_t pid = fork();
+
+            if (pid == 0)
+            {
+                if (WinProcGroup::binding_enabled()) // Before the pool starts
+                    WinProcGroup::bind_process_share(k, jobs);
+
+                Threads.set(threads);
+                analyze(nodes, level, k, jobs, p.depth);
+
+                std::ofstream out(p.outFile + ".job" + std::to_string(k), std::ios::binary);
+                for (size_t i = k; i < level.size(); i += jobs)
+                    out.write(reinterpret_cast<const char*>(&nodes[level[i]].entry), sizeof(AnalysisEntry));
+                out.close();
+
+                Threads.set(0);
+                _exit(out ? 0 : 1);
+            }
+
+            ok = pid > 0;
+
+            if (ok)
+                pids.push_back(pid);
+        }
+
+        for (pid_t pid : pids)
+        {
+            int status;
+            ok &= waitpid(pid, &status, 0) == pid && WIFEXITED(status) && !WEXITSTATUS(status);
+        }
+
+        Threads.set(size_t(Options["Threads"]));
+
+        for (size_t k = 0; k < pids.size(); ++k)
+        {
+            string file = p.outFile + ".job" + std::to_string(k);
+            std::ifstream in(file, std::ios::binary);
+
+            for (size_t i = k; i < level.size() && ok; i += jobs)
+                ok = bool(in.read(reinterpret_cast<char*>(&nodes[level[i]].entry), sizeof(AnalysisEntry)));
+
+            in.close();
+            std::remove(file.c_str());
+        }
+
+        return ok;
+    }
+#endif
+
+    analyze(nodes, level, 0, 1, p.depth);
+    return true;
+  }
+
+
+  // write_polyglot() writes a Polyglot book with the moves of each analyzed
+  // position up to margin cp worse than the best, weighted by their scores.
+  // Returns the number of positions written, or -1 on failure.
+
+  int write_polyglot(const std::vector<Node>& nodes, const Builder::Params& p) {
+
+    std::vector<PolyHash> book;
+    Position pos;
+    int positions = 0;
+
+    for (const Node& n : nodes)
+    {
+        if (!n.entry.move[0])
+            continue;
+
+        StateInfo st;
+        pos.set(n.fen, Options["UCI_Chess960"], &st, Threads.main());
+        Key key = PolyBook::polyglot_key(pos);
+        ++positions;
+
+        for (int l = 0; l < AnalysisEntry::MaxLines && n.entry.move[l]; ++l)
+        {
+            int loss = (n.entry.score[0] - n.entry.score[l]) * 100 / PawnValueEg; // In cp
+
+            if (loss > p.margin)
+                continue;
+
+            // Polyglot moves keep our from and to squares, castling included as
+            // king captures rook, with the promotion piece from knight = 1.
+            Move m = Move(n.entry.move[l]);
+            uint16_t move = uint16_t(m & 0xFFF);
+
+            if (type_of(m) == PROMOTION)
+                move |= uint16_t((promotion_type(m) - 1) << 12);
+
+            book.push_back({ key, move, uint16_t(std::max(1, 100 - 100 * loss / (p.margin + 1))), 0 });
+        }
+    }
+
+    std::sort(book.begin(), book.end(), [](const PolyHash& a, const PolyHash& b) {
+        return a.key != b.key ? a.key < b.key : a.weight > b.weight;
+    });
+
+    // Polyglot files are big-endian
+    auto put = [](std::ofstream& out, uint64_t v, int bytes) {
+        while (bytes--)
+            out.put(char(v >> (8 * bytes)));
+    };
+
+    string tmp = p.outFile + ".tmp";
+    std::ofstream out(tmp, std::ios::binary);
+
+    for (const PolyHash& e : book)
+        put(out, e.key, 8), put(out, e.move, 2), put(out, e.weight, 2), put(out, e.learn, 4);
+
+    out.close();
+
+#ifdef _WIN32
+    std::remove(p.outFile.c_str()); // No replacing rename on Windows
+#endif
+
+    if (!out || std::rename(tmp.c_str(), p.outFile.c_str()))
+    {
+        std::remove(tmp.c_str());
+        return -1;
+    }
+
+    return positions;
+  }
+
+} // namespace
+
+
+/// Builder::build() reads the seed positions and analyzes them, then grows the
+/// tree a ply at a time by playing the moves up to margin cp worse than the
+/// best one from each position of the last level, each new position once.
+/// Each level is searched by the jobs in parallel.
+
+bool Builder::build(const Params& p) {
+
+  std::ifstream in(p.seedFile);
+  std::vector<string> seeds;
+
+  if (!in)
+  {
+      sync_cout << "info string Could not open " << p.seedFile << sync_endl;
+      return false;
+  }
+
+  bool pgn = p.seedFile.size() > 4 && p.seedFile.compare(p.seedFile.size() - 4, 4, ".pgn") == 0;
+  bool polyglot = p.outFile.size() > 4 && p.outFile.compare(p.outFile.size() - 4, 4, ".bin") == 0;
+
+  if (pgn)
+      read_pgn(in, seeds);
+  else
+      read_epd(in, seeds);
+
+  std::vector<Node> nodes;
+  std::vector<size_t> level;
+  std::set<Key> seen;
+  Position pos;
+
+  for (const string& fen : seeds)
+  {
+      StateInfo st;
+      pos.set(fen, Options["UCI_Chess960"], &st, Threads.main());
+
+      if (seen.insert(pos.key()).second)
+          nodes.push_back({ fen, 0, {} }), level.push_back(nodes.size() - 1);
+  }
+
+  int multiPV = int(Options["MultiPV"]);
+  bool ownBook = bool(Options["OwnBook"]);
+  Options["MultiPV"] = std::to_string(AnalysisEntry::MaxLines);
+  Options["OwnBook"] = string("false");
+
+  TimePoint start = now();
+  bool ok = true;
+
+  for (int ply = 0; ok && !level.empty(); ++ply)
+  {
+      ok = analyze_level(nodes, level, p);
+
+      sync_cout << "info string ply " << ply << ": analyzed " << level.size()
+                << " positions, " << nodes.size() << " in all, in "
+                << (now() - start) / 1000 << " s" << sync_endl;
+
+      std::vector<size_t> next;
+
+      for (size_t idx : level)
+      {
+          const AnalysisEntry e = nodes[idx].entry; // Copied, nodes grow below
+          int childPly = nodes[idx].ply + 1;
+
+          if (!ok || childPly > p.plies || !e.move[0])
+              continue;
+
+          StateListPtr states(new std::deque<StateInfo>(1));
+          pos.set(nodes[idx].fen, Options["UCI_Chess960"], &states->back(), Threads.main());
+
+          for (int l = 0; l < AnalysisEntry::MaxLines && e.move[l]; ++l)
+          {
+              if ((e.score[0] - e.score[l]) * 100 / PawnValueEg > p.margin)
+                  continue;
+
+              Move m = Move(e.move[l]);
+              states->emplace_back();
+              pos.do_move(m, states->back());
+
+              if (seen.insert(pos.key()).second)
+                  nodes.push_back({ pos.fen(), childPly, {} }), next.push_back(nodes.size() - 1);
+
+              pos.undo_move(m);
+          }
+      }
+
+      level.swap(next);
+  }
+
+  Options["MultiPV"] = std::to_string(multiPV);
+  Options["OwnBook"] = string(ownBook ? "true" : "false");
+
+  if (!ok)
+  {
+      sync_cout << "info string Build failed, a job did not finish" << sync_endl;
+      return false;
+  }
+
+  std::vector<AnalysisEntry> entries;
+
+  for (const Node& n : nodes)
+      if (n.entry.move[0])
+          entries.push_back(n.entry);
+
+  int written = polyglot ? write_polyglot(nodes, p)
+              : AnalysisDB::write(p.outFile, entries) ? int(entries.size()) : -1;
+
+  if (written < 0)
+  {
+      sync_cout << "info string Could not write " << p.outFile << sync_endl;
+      return false;
+  }
+
+  sync_cout << "info string Wrote " << written << " positions to " << p.outFile << sync_endl;
+  return true;
+}
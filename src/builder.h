@@ -0,0 +1,47 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2020 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BUILDER_H_INCLUDED
+#define BUILDER_H_INCLUDED
+
+#include <string>
+
+#include "types.h"
+
+namespace Builder {
+
+/// Builder::Params are the settings of a book or analysis file build
+
+struct Params {
+  std::string seedFile;   // PGN games, or FEN/EPD positions one per line
+  std::string outFile;    // A Polyglot book if ending in ".bin", else an analysis file
+  Depth depth = 20;       // Search depth of each position
+  int plies = 0;          // Plies the tree is grown beyond the seed positions
+  int margin = 30;        // Moves up to this many cp worse than the best are kept
+  int jobs = 1;           // Positions searched at once, each by its own process
+};
+
+/// Builder::build() analyzes the seed positions and the tree grown from them,
+/// level by level, and writes the result. Returns false on failure, which has
+/// been reported.
+
+bool build(const Params& params);
+
+} // namespace Builder
+
+#endif // #ifndef BUILDER_H_INCLUDED
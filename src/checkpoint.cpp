@@ -0,0 +1,289 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2020 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "checkpoint.h"
+#include "misc.h"
+#include "movegen.h"
+#include "thread.h"
+#include "tt.h"
+#include "uci.h"
+
+namespace {
+
+  // A checkpoint is written in native byte order, for the same build to read:
+  //
+  // magic, hash size in MB, Chess960 flag, root FEN, completed depth,
+  // PV lines (score, selDepth, moves), hash table,
+  // thread count, for each thread: own continuation history flag, histories
+
+  constexpr char FileMagic[8] = { 'S', 'F', 'C', 'K', 'P', 'T', '0', '1' };
+
+  template<typename T> void put(std::ostream& os, const T& v) {
+    os.write(reinterpret_cast<const char*>(&v), sizeof(T));
+  }
+
+  template<typename T> bool get(std::istream& is, T& v) {
+    return bool(is.read(reinterpret_cast<char*>(&v), sizeof(T)));
+  }
+
+  // Whether the thread has its own continuation history, not the main one's
+  bool own_continuation(const SFThread* th) {
+    return th == Threads.main() || th->continuationHistory != Threads.main()->continuationHistory;
+  }
+
+  // Calls f with the address and size of each history table of the thread, in
+  // file order. The continuation history comes last, when included.
+  template<typename F>
+  void histories(SFThread* th, bool continuation, F f) {
+    f(&th->mainHistory, sizeof(th->mainHistory));
+    f(&th->lowPlyHistory, sizeof(th->lowPlyHistory));
+    f(&th->captureHistory, sizeof(th->captureHistory));
+    f(&th->counterMoves, sizeof(th->counterMoves));
+
+    if (continuation)
+        f(&th->continuationHistory[0][0], 4 * sizeof(ContinuationHistory));
+  }
+
+} // namespace
+
+
+/// Checkpoint::save() takes the PV lines from the results published by the main
+/// thread, so that they can be read safely while it searches. Hash and history
+/// tables are copied as they are, like the lockless hash table is read during
+/// a search. The file is written next to the target and then renamed over it,
+/// so a crash while writing leaves the previous checkpoint intact.
+
+bool Checkpoint::save(const std::string& path) {
+
+  MainThread* main = Threads.main();
+  TimePoint start = now();
+
+  if (path.empty() || main->results.head() == main->resultsStart)
+  {
+      sync_cout << "info string Nothing to checkpoint, or no file given" << sync_endl;
+      return false;
+  }
+
+  // The lines are those of the last report of the completed depth with exact
+  // scores only, lines 1 to n in order. The completed depth is read first, as
+  // it is set after the lines of its last report are published: reports of a
+  // later iteration, partial or failing high or low, are left out.
+  Depth depth = main->completedDepth;
+  std::vector<Search::PVRecord> lines, report;
+  Search::PVRecord r;
+  uint64_t cursor = main->resultsStart;
+  bool exact = false;
+
+  while (main->results.poll(cursor, r))
+  {
+      if (r.multiPV == 1)
+          report.clear(), exact = r.depth == depth;
+
+      exact = exact && r.bound == BOUND_EXACT && r.depth <= depth && size_t(r.multiPV) == report.size() + 1;
+      report.push_back(r);
+
+      if (exact)
+          lines = report;
+  }
+
+  const Position& root = Threads.root();
+  MoveList<LEGAL> legal(root);
+  size_t n = 0;
+
+  while (   n < lines.size()
+         && lines[n].pvLength
+         && legal.contains(lines[n].move())
+         && std::none_of(lines.begin(), lines.begin() + n,
+                         [&](const Search::PVRecord& l) { return l.move() == lines[n].move(); }))
+      ++n;
+
+  lines.resize(n);
+
+  std::string tmp = path + ".tmp";
+  std::ofstream os(tmp, std::ios::binary);
+  std::string fen = root.fen();
+
+  os.write(FileMagic, sizeof(FileMagic));
+  put(os, uint32_t(size_t(Options["Hash"])));
+  put(os, uint32_t(root.is_chess960()));
+  put(os, uint32_t(fen.size()));
+  os.write(fen.data(), std::streamsize(fen.size()));
+  put(os, int32_t(depth));
+  put(os, uint32_t(lines.size()));
+
+  for (const auto& l : lines)
+  {
+      put(os, int32_t(l.score));
+      put(os, int32_t(l.selDepth));
+      put(os, uint32_t(l.pvLength));
+
+      for (int i = 0; i < l.pvLength; ++i)
+          put(os, uint16_t(l.pv[i]));
+  }
+
+  TT.save(os);
+  put(os, uint32_t(Threads.size()));
+
+  for (SFThread* th : Threads)
+  {
+      bool own = own_continuation(th);
+      put(os, uint8_t(own));
+      histories(th, own, [&](const void* p, size_t size) {
+          os.write(static_cast<const char*>(p), std::streamsize(size));
+      });
+  }
+
+  os.close();
+
+#ifdef _WIN32
+  std::remove(path.c_str()); // No replacing rename on Windows
+#endif
+
+  if (!os || std::rename(tmp.c_str(), path.c_str()))
+  {
+      std::remove(tmp.c_str());
+      sync_cout << "info string Could not write checkpoint " << path << sync_endl;
+      return false;
+  }
+
+  sync_cout << "info string Checkpoint at depth " << depth
+            << " with " << lines.size() << " lines written to " << path
+            << " in " << now() - start << " ms" << sync_endl;
+
+  return true;
+}
+
+
+/// Checkpoint::load() should be called with no search running. The hash size
+/// is set to the saved one if it differs. Saved threads beyond the current
+/// ones are skipped, and with shared histories the helpers' own continuation
+/// histories are too. On failure the position and the hash size are left as
+/// they were, and the hash table and the histories are cleared, as after
+/// "ucinewgame", as they may be partly overwritten.
+
+bool Checkpoint::load(const std::string& path, Position& pos, StateListPtr& states, Search::LimitsType& limits) {
+
+  std::ifstream is(path, std::ios::binary);
+  char magic[sizeof(FileMagic)];
+  uint32_t hashMB, chess960, fenSize, lineCount, threads;
+  int32_t depth;
+  std::string fen;
+  std::string oldHash = std::to_string(size_t(Options["Hash"]));
+
+  auto fail = [&](const char* reason) {
+      sync_cout << "info string Could not resume from " << path << ": " << reason << sync_endl;
+      return false;
+  };
+
+  if (   !is.read(magic, sizeof(magic))
+      || memcmp(magic, FileMagic, sizeof(FileMagic))
+      || !get(is, hashMB)
+      || !get(is, chess960)
+      || !get(is, fenSize)
+      || !fenSize
+      || fenSize > 256)
+      return fail("not a checkpoint file");
+
+  fen.resize(fenSize);
+
+  if (!is.read(&fen[0], std::streamsize(fenSize)))
+      return fail("truncated file");
+
+  StateListPtr newStates(new std::deque<StateInfo>(1));
+  Position root;
+  root.set(fen, chess960, &newStates->back(), Threads.main());
+  Search::RootMoves rootLines;
+
+  if (!get(is, depth) || !get(is, lineCount))
+      return fail("truncated file");
+
+  if (depth < 0 || depth >= MAX_PLY)
+      return fail("invalid depth");
+
+  for (uint32_t i = 0; i < lineCount; ++i)
+  {
+      int32_t score, selDepth;
+      uint32_t length;
+      std::vector<Move> pv;
+
+      if (!get(is, score) || !get(is, selDepth) || !get(is, length) || !length)
+          return fail("truncated file");
+
+      for (uint16_t m; pv.size() < length && get(is, m); )
+          pv.push_back(Move(m));
+
+      if (pv.size() < length || !MoveList<LEGAL>(root).contains(pv[0]))
+          return fail("invalid PV line");
+
+      rootLines.emplace_back(pv[0]);
+      rootLines.back().pv = pv;
+      rootLines.back().score = Value(score);
+      rootLines.back().selDepth = selDepth;
+  }
+
+  // From here on tables are overwritten, to be cleared on failure
+  auto rollback = [&](const char* reason) {
+      if (std::to_string(size_t(Options["Hash"])) != oldHash)
+          Options["Hash"] = oldHash;
+      Search::clear();
+      return fail(reason);
+  };
+
+  if (size_t(Options["Hash"]) != hashMB)
+      Options["Hash"] = std::to_string(hashMB);
+
+  if (!TT.load(is) || !get(is, threads))
+      return rollback("hash table does not match");
+
+  for (uint32_t k = 0; k < threads; ++k)
+  {
+      SFThread* th = k < Threads.size() ? Threads[k] : nullptr;
+      uint8_t own;
+
+      if (!get(is, own))
+          break;
+
+      // The main thread only gives the table sizes of a skipped thread
+      SFThread* target = th ? th : Threads.main();
+      histories(target, own, [&](void* p, size_t size) {
+          if (th && (p != &th->continuationHistory[0][0] || own_continuation(th)))
+              is.read(static_cast<char*>(p), std::streamsize(size));
+          else
+              is.ignore(std::streamsize(size));
+      });
+  }
+
+  if (!is)
+      return rollback("truncated file");
+
+  states = std::move(newStates);
+  pos.set(fen, chess960, &states->back(), Threads.main());
+
+  limits.startDepth = depth;
+  limits.rootLines = rootLines;
+  Threads.main()->bestPreviousScore = rootLines.empty() ? VALUE_INFINITE : rootLines[0].score;
+
+  return true;
+}
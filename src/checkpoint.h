@@ -0,0 +1,44 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2020 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHECKPOINT_H_INCLUDED
+#define CHECKPOINT_H_INCLUDED
+
+#include <string>
+
+#include "position.h"
+#include "search.h"
+
+namespace Checkpoint {
+
+/// Checkpoint::save() writes the state of the last search started, running or
+/// not, to a file: its root position, the depth completed and the PV lines,
+/// the hash table and the history tables of each thread. Returns false on
+/// failure, which has been reported.
+
+bool save(const std::string& path);
+
+/// Checkpoint::load() restores the hash table and the histories from a file
+/// written by save(), sets the position and fills in the limits so that a
+/// search started with them goes on from where the saved one was.
+
+bool load(const std::string& path, Position& pos, StateListPtr& states, Search::LimitsType& limits);
+
+} // namespace Checkpoint
+
+#endif // #ifndef CHECKPOINT_H_INCLUDED
@@ -1019,13 +1019,20 @@ make_v:
 Value Eval::evaluate(const Position& pos) {
 
   Value v;
+  Search::SearchStats& stats = pos.this_thread()->stats;
+
+  auto classical_eval = [&](){
+     stats.inc(Search::EvalClassical);
+     return Evaluation<NO_TRACE>(pos).value();
+  };
 
   if (!Eval::useNNUE)
-      v = Evaluation<NO_TRACE>(pos).value();
+      v = classical_eval();
   else
   {
       // Scale and shift NNUE for compatibility with search and classical evaluation
       auto  adjusted_NNUE = [&](){
+         stats.inc(Search::EvalNnue);
          int mat = pos.non_pawn_material() + PieceValue[MG][PAWN] * pos.count<PAWN>();
          return NNUE::evaluate(pos) * (720 + mat / 32) / 1024 + Tempo;
       };
@@ -1036,7 +1043,7 @@ Value Eval::evaluate(const Position& pos) {
       bool  largePsq = psq * 16 > (NNUEThreshold1 + pos.non_pawn_material() / 64) * r50;
       bool  classical = largePsq || (psq > PawnValueMg / 4 && !(pos.this_thread()->nodes & 0xB));
 
-      v = classical ? Evaluation<NO_TRACE>(pos).value() : adjusted_NNUE();
+      v = classical ? classical_eval() : adjusted_NNUE();
 
       // If the classical eval is small and imbalance large, use NNUE nevertheless.
       // For the case of opposite colored bishops, switch to NNUE eval with
@@ -116,13 +116,20 @@ namespace Material {
 /// is found. Otherwise a new Entry is computed and stored there, so we don't
 /// have to recompute all when the same material configuration occurs again.
 
-Entry* probe(const Position& pos) {
+PERF_NOINLINE Entry* probe(const Position& pos) {
+
+  PhaseTimer timer(PHASE_HASH_PROBE);
 
   Key key = pos.material_key();
-  Entry* e = pos.this_thread()->materialTable[key];
+  SFThread* th = pos.this_thread();
+  Entry* e = th->materialTable[key];
 
+  th->stats.inc(Search::MaterialProbes);
   if (e->key == key)
+  {
+      th->stats.inc(Search::MaterialHits);
       return e;
+  }
 
   std::memset(e, 0, sizeof(Entry));
   e->key = key;
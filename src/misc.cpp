@@ -47,6 +47,7 @@ typedef bool(*fun3_t)(HANDLE, CONST GROUP_AFFINITY*, PGROUP_AFFINITY);
 #include <cstdlib>
 
 #if defined(__linux__) && !defined(__ANDROID__)
+#include <sched.h>
 #include <stdlib.h>
 #include <sys/mman.h>
 #endif
@@ -58,6 +59,7 @@ typedef bool(*fun3_t)(HANDLE, CONST GROUP_AFFINITY*, PGROUP_AFFINITY);
 
 #include "misc.h"
 #include "thread.h"
+#include "uci.h"
 
 using namespace std;
 
@@ -284,6 +286,48 @@ void dbg_print() {
 }
 
 
+/// Phase timers, summed over all threads
+
+static std::atomic<uint64_t> phaseCycles[PERF_PHASE_NB], phaseCalls[PERF_PHASE_NB];
+
+void phase_add(PerfPhase p, uint64_t cycles) {
+
+  phaseCycles[p].fetch_add(cycles, std::memory_order_relaxed);
+  phaseCalls[p].fetch_add(1, std::memory_order_relaxed);
+}
+
+void phase_clear() {
+
+  for (int p = 0; p < PERF_PHASE_NB; ++p)
+      phaseCycles[p] = phaseCalls[p] = 0;
+}
+
+/// phase_print() prints the cycles, calls and share of the elapsed cycles of
+/// each phase. With several threads the shares can add up to more than 100%.
+
+void phase_print(uint64_t elapsedCycles) {
+
+  static const char* Names[] = {
+    "UpdateAccumulator", "Propagate", "generate", "see_ge", "TT probe", "Material/pawn probe"
+  };
+
+  cerr << "\nPhase                    Mcycles       Calls  Cycles/call  Share\n"
+       << std::fixed << std::setprecision(1);
+
+  for (int p = 0; p < PERF_PHASE_NB; ++p)
+  {
+      uint64_t cycles = phaseCycles[p], calls = phaseCalls[p];
+
+      cerr << std::left << std::setw(20) << Names[p] << std::right
+           << std::setw(12) << cycles / 1000000.0
+           << std::setw(12) << calls
+           << std::setw(13) << (calls ? double(cycles) / calls : 0.0)
+           << std::setw(6) << 100.0 * cycles / std::max(elapsedCycles, uint64_t(1)) << "%\n";
+  }
+  cerr << std::defaultfloat << endl;
+}
+
+
 /// Used to serialize access to std::cout to avoid multiple threads writing at
 /// the same time.
 
@@ -468,12 +512,270 @@ void aligned_large_pages_free(void *mem) {
 
 namespace WinProcGroup {
 
-#ifndef _WIN32
+/// binding_enabled() returns true if search threads should be bound to a set of
+/// logical processors. If the OS already scheduled us on a different group than
+/// 0 then don't overwrite the choice, eventually we are one of many one-threaded
+/// processes running on some NUMA hardware, for instance in fishtest. To make it
+/// simple, in "Auto" mode just check if running threads are below a threshold,
+/// in this case all this NUMA machinery is not needed.
+
+bool binding_enabled() {
+
+  if (Options["Thread Binding"] == "Off")
+      return false;
+
+  return   !(Options["Thread Binding"] == "Auto")
+        || Options["Threads"] > 8
+        || std::string(Options["Thread CPU Set"]) != "<empty>";
+}
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+namespace {
+
+/// parse_cpu_list() converts a Linux style cpu list like "0-3,8,10-11" into
+/// the list of its elements. Malformed and reversed ranges are skipped, and
+/// numbers beyond what a cpu_set_t holds are dropped.
+
+std::vector<int> parse_cpu_list(const std::string& list) {
+
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string range;
+
+  while (std::getline(ss, range, ','))
+  {
+      if (range.find_first_of("0123456789") == std::string::npos)
+          continue;
+
+      // Clamped to the cpu numbers a cpu_set_t holds before expanding
+      size_t dash = range.find('-');
+      long first = std::strtol(range.c_str(), nullptr, 10);
+      long last = dash == std::string::npos ? first : std::strtol(range.c_str() + dash + 1, nullptr, 10);
+
+      first = std::max(first, 0L);
+      last = std::min(last, long(CPU_SETSIZE - 1));
+
+      for (long c = first; c <= last; ++c)
+          cpus.push_back(int(c));
+  }
+
+  return cpus;
+}
+
+
+/// format_cpu_list() is the inverse of parse_cpu_list(), used for reporting
+
+std::string format_cpu_list(const std::vector<int>& cpus) {
+
+  std::stringstream ss;
+
+  for (size_t i = 0; i < cpus.size(); )
+  {
+      size_t j = i;
+      while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+          ++j;
+
+      ss << (i ? "," : "") << cpus[i];
+      if (j > i)
+          ss << "-" << cpus[j];
+
+      i = j + 1;
+  }
+
+  return ss.str();
+}
+
+
+/// numa_nodes() reads the NUMA topology from sysfs and returns the logical
+/// processors of each node, restricted to the ones the process is allowed to
+/// run on and to the "Thread CPU Set" option. Nodes left without processors
+/// are dropped. Without sysfs information we assume a single node.
+
+std::vector<std::vector<int>> numa_nodes() {
+
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+
+  if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed))
+      return {};
+
+  std::string cpuSet = Options["Thread CPU Set"];
+  if (cpuSet != "<empty>")
+  {
+      cpu_set_t restricted;
+      CPU_ZERO(&restricted);
+
+      for (int c : parse_cpu_list(cpuSet))
+          if (c >= 0 && c < CPU_SETSIZE)
+              CPU_SET(c, &restricted);
+
+      CPU_AND(&allowed, &allowed, &restricted);
+  }
+
+  std::vector<std::vector<int>> nodes;
+  std::string online;
+  std::ifstream nodeFile("/sys/devices/system/node/online");
+
+  if (nodeFile.is_open() && std::getline(nodeFile, online))
+      for (int n : parse_cpu_list(online))
+      {
+          std::string cpuList;
+          std::ifstream cpuFile("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+
+          if (!cpuFile.is_open() || !std::getline(cpuFile, cpuList))
+              continue;
+
+          std::vector<int> cpus;
+          for (int c : parse_cpu_list(cpuList))
+              if (c >= 0 && c < CPU_SETSIZE && CPU_ISSET(c, &allowed))
+                  cpus.push_back(c);
+
+          if (!cpus.empty())
+              nodes.push_back(cpus);
+      }
+
+  if (nodes.empty())
+  {
+      std::vector<int> cpus;
+      for (int c = 0; c < CPU_SETSIZE; ++c)
+          if (CPU_ISSET(c, &allowed))
+              cpus.push_back(c);
+
+      if (!cpus.empty())
+          nodes.push_back(cpus);
+  }
+
+  return nodes;
+}
+
+
+/// best_node() returns the node for the thread with index idx. In "Spread" mode
+/// threads are dealt round robin across the nodes, otherwise we run as many
+/// threads as possible on the same node until its processors are exhausted
+/// and then move on filling the next node. If we have more threads than
+/// processors return -1 and let the OS decide within the allowed set.
+
+int best_node(const std::vector<std::vector<int>>& nodes, size_t idx) {
+
+  if (Options["Thread Binding"] == "Spread")
+      return int(idx % nodes.size());
+
+  for (size_t n = 0; n < nodes.size(); idx -= nodes[n++].size())
+      if (idx < nodes[n].size())
+          return int(n);
+
+  return -1;
+}
+
+} // namespace
+
+
+/// bindThisThread() sets the affinity of the current thread to all the allowed
+/// processors of its node. Binding to the whole node rather than to a single
+/// processor keeps the memory locality while leaving the OS free to balance
+/// the load inside the node.
+
+void bindThisThread(size_t idx) {
+
+  // Use only local variables to be thread-safe
+  std::vector<std::vector<int>> nodes = numa_nodes();
+
+  if (nodes.empty())
+      return;
+
+  int node = best_node(nodes, idx);
+
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+
+  for (size_t n = 0; n < nodes.size(); ++n)
+      if (node == -1 || int(n) == node)
+          for (int c : nodes[n])
+              CPU_SET(c, &mask);
+
+  sched_setaffinity(0, sizeof(cpu_set_t), &mask);
+}
+
+
+/// bind_process_share() restricts the calling thread, and the threads it starts
+/// afterwards, to the idx-th of count equal shares of the allowed processors,
+/// taken node by node. Forked jobs searching side by side call it first, so
+/// that their pools are bound within their own share and not all on node 0.
+
+void bind_process_share(size_t idx, size_t count) {
+
+  std::vector<int> cpus;
+
+  for (const auto& node : numa_nodes())
+      cpus.insert(cpus.end(), node.begin(), node.end());
+
+  if (cpus.empty() || count < 2)
+      return;
+
+  size_t first = idx * cpus.size() / count;
+  size_t last = std::max((idx + 1) * cpus.size() / count, first + 1);
+
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+
+  for (size_t i = first; i < last; ++i)
+      CPU_SET(cpus[i % cpus.size()], &mask);
+
+  sched_setaffinity(0, sizeof(cpu_set_t), &mask);
+}
+
+
+/// binding_info() describes how threadCount threads are going to be bound,
+/// it is reported when the thread pool is created.
+
+std::string binding_info(size_t threadCount) {
+
+  std::vector<std::vector<int>> nodes = numa_nodes();
+
+  if (nodes.empty())
+      return "Thread binding unavailable";
+
+  std::vector<size_t> threads(nodes.size(), 0);
+  size_t unbound = 0;
+
+  for (size_t idx = 0; idx < threadCount; ++idx)
+  {
+      int node = best_node(nodes, idx);
+      if (node == -1)
+          ++unbound;
+      else
+          ++threads[node];
+  }
+
+  std::stringstream ss;
+  ss << "Thread binding " << (Options["Thread Binding"] == "Spread" ? "spread" : "compact")
+     << " on " << nodes.size() << " NUMA node" << (nodes.size() > 1 ? "s" : "") << ":";
+
+  for (size_t n = 0; n < nodes.size(); ++n)
+      ss << " node " << n << " cpus " << format_cpu_list(nodes[n])
+         << " threads " << threads[n] << (n + 1 < nodes.size() ? "," : "");
+
+  if (unbound)
+      ss << ", " << unbound << " threads not bound";
+
+  return ss.str();
+}
+
+#elif !defined(_WIN32)
 
 void bindThisThread(size_t) {}
 
+void bind_process_share(size_t, size_t) {}
+
+std::string binding_info(size_t) { return ""; }
+
 #else
 
+std::string binding_info(size_t) { return ""; }
+
+void bind_process_share(size_t, size_t) {}
+
 /// best_group() retrieves logical processor information using Windows specific
 /// API and returns the best group id for the thread with index idx. Original
 /// code from Texel by Peter Österlund.
@@ -28,6 +28,14 @@
 
 #include "types.h"
 
+#if defined(PERF_PHASES) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  include <x86intrin.h> // For __rdtsc()
+#  define USE_RDTSC
+#elif defined(PERF_PHASES) && defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  include <intrin.h>
+#  define USE_RDTSC
+#endif
+
 const std::string engine_info(bool to_uci = false);
 const std::string compiler_info();
 void prefetch(void* addr);
@@ -42,6 +50,38 @@ void dbg_hit_on(bool c, bool b);
 void dbg_mean_of(int v);
 void dbg_print();
 
+/// PerfPhase names the code paths timed in builds with -DPERF_PHASES. The NNUE
+/// and hash probe phases run inside the evaluation, the others do not nest.
+
+enum PerfPhase {
+  PHASE_ACCUMULATOR, PHASE_PROPAGATE, PHASE_GENERATE, PHASE_SEE,
+  PHASE_TT_PROBE, PHASE_HASH_PROBE, PERF_PHASE_NB
+};
+
+inline uint64_t cpu_cycles() {
+#ifdef USE_RDTSC
+  return __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+void phase_add(PerfPhase p, uint64_t cycles);
+void phase_clear();
+void phase_print(uint64_t elapsedCycles);
+
+/// PhaseTimer adds the cycles spent in its scope to a phase. Without
+/// -DPERF_PHASES it does nothing and compiles away.
+
+struct PhaseTimer {
+  explicit PhaseTimer(PerfPhase p) : phase(p), start(HasPerfPhases ? cpu_cycles() : 0) {}
+  ~PhaseTimer() { if (HasPerfPhases) phase_add(phase, cpu_cycles() - start); }
+
+private:
+  PerfPhase phase;
+  uint64_t start;
+};
+
 typedef std::chrono::milliseconds::rep TimePoint; // A value in milliseconds
 static_assert(sizeof(TimePoint) == sizeof(int64_t), "TimePoint should be 64 bits");
 inline TimePoint now() {
@@ -131,9 +171,17 @@ inline uint64_t mul_hi64(uint64_t a, uint64_t b) {
 /// cores. To overcome this, some special platform specific API should be
 /// called to set group affinity for each thread. Original code from Texel by
 /// Peter Österlund.
+///
+/// Under Linux the same entry point pins each search thread to the CPUs of a
+/// NUMA node read from sysfs, following the "Thread Binding" policy and the
+/// "Thread CPU Set" restriction, so that threads stay close to the memory
+/// they first touched.
 
 namespace WinProcGroup {
+  bool binding_enabled();
   void bindThisThread(size_t idx);
+  void bind_process_share(size_t idx, size_t count);
+  std::string binding_info(size_t threadCount);
 }
 
 namespace CommandLine {
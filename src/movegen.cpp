@@ -18,6 +18,7 @@
 
 #include <cassert>
 
+#include "misc.h"
 #include "movegen.h"
 #include "position.h"
 
@@ -266,11 +267,13 @@ namespace {
 /// Returns a pointer to the end of the move list.
 
 template<GenType Type>
-ExtMove* generate(const Position& pos, ExtMove* moveList) {
+PERF_NOINLINE ExtMove* generate(const Position& pos, ExtMove* moveList) {
 
   static_assert(Type == CAPTURES || Type == QUIETS || Type == NON_EVASIONS, "Unsupported type in generate()");
   assert(!pos.checkers());
 
+  PhaseTimer timer(PHASE_GENERATE);
+
   Color us = pos.side_to_move();
 
   return us == WHITE ? generate_all<WHITE, Type>(pos, moveList)
@@ -286,10 +289,12 @@ template ExtMove* generate<NON_EVASIONS>(const Position&, ExtMove*);
 /// generate<QUIET_CHECKS> generates all pseudo-legal non-captures.
 /// Returns a pointer to the end of the move list.
 template<>
-ExtMove* generate<QUIET_CHECKS>(const Position& pos, ExtMove* moveList) {
+PERF_NOINLINE ExtMove* generate<QUIET_CHECKS>(const Position& pos, ExtMove* moveList) {
 
   assert(!pos.checkers());
 
+  PhaseTimer timer(PHASE_GENERATE);
+
   Color us = pos.side_to_move();
   Bitboard dc = pos.blockers_for_king(~us) & pos.pieces(us) & ~pos.pieces(PAWN);
 
@@ -315,10 +320,12 @@ ExtMove* generate<QUIET_CHECKS>(const Position& pos, ExtMove* moveList) {
 /// generate<EVASIONS> generates all pseudo-legal check evasions when the side
 /// to move is in check. Returns a pointer to the end of the move list.
 template<>
-ExtMove* generate<EVASIONS>(const Position& pos, ExtMove* moveList) {
+PERF_NOINLINE ExtMove* generate<EVASIONS>(const Position& pos, ExtMove* moveList) {
 
   assert(pos.checkers());
 
+  PhaseTimer timer(PHASE_GENERATE);
+
   Color us = pos.side_to_move();
   Square ksq = pos.square<KING>(us);
   Bitboard sliderAttacks = 0;
@@ -18,6 +18,10 @@
 
 #include <cassert>
 
+#if defined(USE_AVX2)
+#include <immintrin.h>
+#endif
+
 #include "movepick.h"
 
 namespace {
@@ -44,6 +48,49 @@ namespace {
         }
   }
 
+#if defined(USE_AVX2)
+  // score_quiets() sums the quiet histories of the moves in [begin, end) eight
+  // at a time and returns where it stopped, leaving the last few to the caller.
+  // The int16 entries are gathered as 32-bit words and sign extended from their
+  // low half. The two extra bytes are never read past a table, as no move has
+  // the last piece or from-to index.
+  ExtMove* score_quiets(ExtMove* begin, ExtMove* end, const Position& pos,
+                        const int16_t* mh, const int16_t* lph, int lphWeight,
+                        const PieceToHistory** ch) {
+
+    auto gather = [](const void* table, __m256i idx) {
+        __m256i v = _mm256_i32gather_epi32(static_cast<const int*>(table), idx, 2);
+        return _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+    };
+
+    for ( ; end - begin >= 8; begin += 8)
+    {
+        alignas(32) int fromTo[8], pieceTo[8], value[8];
+
+        for (int i = 0; i < 8; ++i)
+        {
+            fromTo[i]  = from_to(begin[i]);
+            pieceTo[i] = pos.moved_piece(begin[i]) * SQUARE_NB + to_sq(begin[i]);
+        }
+
+        __m256i ft = _mm256_load_si256(reinterpret_cast<const __m256i*>(fromTo));
+        __m256i pt = _mm256_load_si256(reinterpret_cast<const __m256i*>(pieceTo));
+
+        __m256i ch013 = _mm256_add_epi32(_mm256_add_epi32(gather(ch[0], pt), gather(ch[1], pt)), gather(ch[3], pt));
+        __m256i sum = _mm256_add_epi32(_mm256_add_epi32(gather(mh, ft), gather(ch[5], pt)), _mm256_slli_epi32(ch013, 1));
+
+        if (lph)
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(gather(lph, ft), _mm256_set1_epi32(lphWeight)));
+
+        _mm256_store_si256(reinterpret_cast<__m256i*>(value), sum);
+
+        for (int i = 0; i < 8; ++i)
+            begin[i].value = value[i];
+    }
+    return begin;
+  }
+#endif
+
 } // namespace
 
 
@@ -98,7 +145,20 @@ void MovePicker::score() {
 
   static_assert(Type == CAPTURES || Type == QUIETS || Type == EVASIONS, "Wrong type");
 
-  for (auto& m : *this)
+  ExtMove* it = begin();
+
+#if defined(USE_AVX2)
+  if (Type == QUIETS)
+      it = score_quiets(it, end(), pos,
+                        reinterpret_cast<const int16_t*>(&(*mainHistory)[pos.side_to_move()]),
+                        ply < MAX_LPH ? reinterpret_cast<const int16_t*>(&(*lowPlyHistory)[ply]) : nullptr,
+                        std::min(4, depth / 3), continuationHistory);
+#endif
+
+  for ( ; it < end(); ++it)
+  {
+      ExtMove& m = *it;
+
       if (Type == CAPTURES)
           m.value =  int(PieceValue[MG][pos.piece_on(to_sq(m))]) * 6
                    + (*captureHistory)[pos.moved_piece(m)][to_sq(m)][type_of(pos.piece_on(to_sq(m)))];
@@ -121,6 +181,7 @@ void MovePicker::score() {
                        + (*continuationHistory[0])[pos.moved_piece(m)][to_sq(m)]
                        - (1 << 28);
       }
+  }
 }
 
 /// MovePicker::select() returns the next move satisfying a predicate function.
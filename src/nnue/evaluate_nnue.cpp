@@ -149,7 +149,10 @@ namespace Eval::NNUE {
     ASSERT_ALIGNED(buffer, alignment);
 
     feature_transformer->Transform(pos, transformed_features);
-    const auto output = network->Propagate(transformed_features, buffer);
+    const auto output = [&]{
+      PhaseTimer timer(PHASE_PROPAGATE);
+      return network->Propagate(transformed_features, buffer);
+    }();
 
     return static_cast<Value>(output[0] / FV_SCALE);
   }
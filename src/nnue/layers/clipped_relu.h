@@ -60,7 +60,7 @@ namespace Eval::NNUE::Layers {
     }
 
     // Forward propagation
-    const OutputType* Propagate(
+    PERF_NOINLINE const OutputType* Propagate(
         const TransformedFeatureType* transformed_features, char* buffer) const {
       const auto input = previous_layer_.Propagate(
           transformed_features, buffer + kSelfBufferSize);
@@ -21,6 +21,7 @@
 #ifndef NNUE_FEATURE_TRANSFORMER_H_INCLUDED
 #define NNUE_FEATURE_TRANSFORMER_H_INCLUDED
 
+#include "../misc.h"
 #include "nnue_common.h"
 #include "nnue_architecture.h"
 #include "features/index_list.h"
@@ -236,7 +237,9 @@ namespace Eval::NNUE {
     }
 
    private:
-    void UpdateAccumulator(const Position& pos, const Color c) const {
+    PERF_NOINLINE void UpdateAccumulator(const Position& pos, const Color c) const {
+
+      PhaseTimer timer(PHASE_ACCUMULATOR);
 
   #ifdef VECTOR
       // Gcc-10.2 unnecessarily spills AVX2 registers if this array
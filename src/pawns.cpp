@@ -193,13 +193,20 @@ namespace Pawns {
 /// is found. Otherwise a new Entry is computed and stored there, so we don't
 /// have to recompute all when the same pawns configuration occurs again.
 
-Entry* probe(const Position& pos) {
+PERF_NOINLINE Entry* probe(const Position& pos) {
+
+  PhaseTimer timer(PHASE_HASH_PROBE);
 
   Key key = pos.pawn_key();
-  Entry* e = pos.this_thread()->pawnsTable[key];
+  SFThread* th = pos.this_thread();
+  Entry* e = th->pawnsTable[key];
 
+  th->stats.inc(Search::PawnProbes);
   if (e->key == key)
+  {
+      th->stats.inc(Search::PawnHits);
       return e;
+  }
 
   e->key = key;
   e->blockedCount = 0;
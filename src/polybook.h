@@ -44,9 +44,10 @@ public:
 
     Move probe(Position& pos);
 
+    static Key polyglot_key(const Position& pos);
+
 private:
 
-    Key polyglot_key(const Position& pos);
     Move pg_move_to_sf_move(const Position & pos, unsigned short pg_move);
 
     int find_first_key(uint64_t key);
@@ -281,6 +281,7 @@ Position& Position::set(const string& fenStr, bool isChess960, StateInfo* si, SF
   chess960 = isChess960;
   thisThread = th;
   set_state(st);
+  set_key_count();
   st->accumulator.state[WHITE] = Eval::NNUE::INIT;
   st->accumulator.state[BLACK] = Eval::NNUE::INIT;
 
@@ -393,6 +394,43 @@ Position& Position::set(const string& code, Color c, StateInfo* si) {
 }
 
 
+/// Position::set() is an overload to initialize the position object as a copy
+/// of another position, which is much cheaper than a round trip through fen().
+/// The caller provides in 'si' a copy of the current state of 'pos', earlier
+/// states are shared since they are read-only.
+
+Position& Position::set(const Position& pos, StateInfo* si, SFThread* th) {
+
+  assert(si->key == pos.key());
+
+  std::memcpy(static_cast<void*>(this), &pos, sizeof(Position));
+  st = si;
+  thisThread = th;
+  set_key_count();
+
+  assert(pos_is_ok());
+
+  return *this;
+}
+
+
+/// Position::set_key_count() counts the keys of the current state and of the
+/// earlier states that repetition detection can reach from it.
+
+void Position::set_key_count() {
+
+  std::memset(keyCount, 0, sizeof(keyCount));
+
+  StateInfo* stp = st;
+  for (int i = std::min(st->rule50, st->pliesFromNull); stp; stp = stp->previous)
+  {
+      ++key_count(stp->key);
+      if (--i < 0)
+          break;
+  }
+}
+
+
 /// Position::fen() returns a FEN representation of the position. In case of
 /// Chess960 the Shredder-FEN notation is used. This is mainly a debugging function.
 
@@ -869,6 +907,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
   // Calculate checkers bitboard (if move gives check)
   st->checkersBB = givesCheck ? attackers_to(square<KING>(them)) & pieces(us) : 0;
+  st->seeSquares = 0;
 
   sideToMove = ~sideToMove;
 
@@ -880,7 +919,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
   // if the position was not repeated.
   st->repetition = 0;
   int end = std::min(st->rule50, st->pliesFromNull);
-  if (end >= 4)
+  if (end >= 4 && key_count(st->key))
   {
       StateInfo* stp = st->previous->previous;
       for (int i = 4; i <= end; i += 2)
@@ -893,6 +932,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
           }
       }
   }
+  ++key_count(st->key);
 
   assert(pos_is_ok());
 }
@@ -955,6 +995,7 @@ void Position::undo_move(Move m) {
   }
 
   // Finally point our state pointer back to the previous state
+  --key_count(st->key);
   st = st->previous;
   --gamePly;
 
@@ -1008,6 +1049,7 @@ void Position::do_null_move(StateInfo& newSt) {
 
   st->dirtyPiece.dirty_num = 0;
   st->dirtyPiece.piece[0] = NO_PIECE; // Avoid checks in UpdateAccumulator()
+  st->seeSquares = 0;
   st->accumulator.state[WHITE] = Eval::NNUE::EMPTY;
   st->accumulator.state[BLACK] = Eval::NNUE::EMPTY;
 
@@ -1028,6 +1070,7 @@ void Position::do_null_move(StateInfo& newSt) {
   set_check_info(st);
 
   st->repetition = 0;
+  ++key_count(st->key);
 
   assert(pos_is_ok());
 }
@@ -1036,6 +1079,7 @@ void Position::undo_null_move() {
 
   assert(!checkers());
 
+  --key_count(st->key);
   st = st->previous;
   sideToMove = ~sideToMove;
 }
@@ -1064,10 +1108,12 @@ Key Position::key_after(Move m) const {
 /// SEE value of move is greater or equal to the given threshold. We'll use an
 /// algorithm similar to alpha-beta pruning with a null window.
 
-bool Position::see_ge(Move m, Value threshold) const {
+PERF_NOINLINE bool Position::see_ge(Move m, Value threshold) const {
 
   assert(is_ok(m));
 
+  PhaseTimer timer(PHASE_SEE);
+
   // Only deal with normal moves, assume others pass a simple see
   if (type_of(m) != NORMAL)
       return VALUE_ZERO >= threshold;
@@ -1084,8 +1130,16 @@ bool Position::see_ge(Move m, Value threshold) const {
 
   Bitboard occupied = pieces() ^ from ^ to;
   Color stm = color_of(piece_on(from));
-  Bitboard attackers = attackers_to(to, occupied);
+  Bitboard attackers = see_attackers(to);
   Bitboard stmAttackers, bb;
+
+  // The attackers of 'to' are cached per position, so add the sliders that
+  // were behind the moving piece, as for any later capture below.
+  if (PseudoAttacks[BISHOP][to] & from)
+      attackers |= attacks_bb<BISHOP>(to, occupied) & pieces(BISHOP, QUEEN);
+
+  else if (PseudoAttacks[ROOK][to] & from)
+      attackers |= attacks_bb<ROOK>(to, occupied) & pieces(ROOK, QUEEN);
   int res = 1;
 
   while (true)
@@ -59,6 +59,10 @@ struct StateInfo {
   // Used by NNUE
   Eval::NNUE::Accumulator accumulator;
   DirtyPiece dirtyPiece;
+
+  // Attackers of the squares in seeSquares, computed on demand by see_ge()
+  Bitboard   seeSquares;
+  Bitboard   seeAttackers[SQUARE_NB];
 };
 
 
@@ -86,6 +90,7 @@ public:
   // FEN string input/output
   Position& set(const std::string& fenStr, bool isChess960, StateInfo* si, SFThread* th);
   Position& set(const std::string& code, Color c, StateInfo* si);
+  Position& set(const Position& pos, StateInfo* si, SFThread* th);
   const std::string fen() const;
 
   // Position representation
@@ -119,6 +124,7 @@ public:
   // Attacks to/from a given square
   Bitboard attackers_to(Square s) const;
   Bitboard attackers_to(Square s, Bitboard occupied) const;
+  Bitboard see_attackers(Square s) const;
   Bitboard slider_blockers(Bitboard sliders, Square s, Bitboard& pinners) const;
 
   // Properties of moves
@@ -177,8 +183,10 @@ private:
   void set_castling_right(Color c, Square rfrom);
   void set_state(StateInfo* si) const;
   void set_check_info(StateInfo* si) const;
+  void set_key_count();
 
   // Other helpers
+  uint16_t& key_count(Key k);
   void put_piece(Piece pc, Square s);
   void remove_piece(Square s);
   void move_piece(Square from, Square to);
@@ -201,6 +209,13 @@ private:
   SFThread* thisThread;
   StateInfo* st;
   bool chess960;
+
+  // Number of keys in the state list indexed by their low bits: the keys in the
+  // 50-move window when the position was set, plus those of the moves made since.
+  // A zero count proves that a key did not occur, so do_move() only scans the
+  // earlier states for a repetition when the count is set.
+  static constexpr int KeyCountSize = 1024;
+  uint16_t keyCount[KeyCountSize];
 };
 
 namespace PSQT {
@@ -295,6 +310,16 @@ inline Bitboard Position::attackers_to(Square s) const {
   return attackers_to(s, pieces());
 }
 
+inline Bitboard Position::see_attackers(Square s) const {
+
+  if (!(st->seeSquares & s))
+  {
+      st->seeSquares |= s;
+      st->seeAttackers[s] = attackers_to(s);
+  }
+  return st->seeAttackers[s];
+}
+
 inline Bitboard Position::checkers() const {
   return st->checkersBB;
 }
@@ -389,6 +414,10 @@ inline SFThread* Position::this_thread() const {
   return thisThread;
 }
 
+inline uint16_t& Position::key_count(Key k) {
+  return keyCount[k & (KeyCountSize - 1)];
+}
+
 inline void Position::put_piece(Piece pc, Square s) {
 
   board[s] = pc;
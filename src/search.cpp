@@ -20,9 +20,12 @@
 #include <cassert>
 #include <cmath>
 #include <cstring>   // For std::memset
+#include <iomanip>
 #include <iostream>
+#include <numeric>
 #include <sstream>
 
+#include "analysisdb.h"
 #include "polybook.h"
 #include "evaluate.h"
 #include "misc.h"
@@ -86,6 +89,18 @@ namespace {
     return d > 13 ? 29 : 17 * d * d + 134 * d - 134;
   }
 
+  // Sizes and phases of the skip-blocks, used for distributing search depths
+  // across the helper threads when "SMP Depth Skip" is enabled
+  constexpr int SkipSize[]  = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+  constexpr int SkipPhase[] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
+
+  // Depth of the given PV line at the given iteration depth. With "MultiPV Reduction"
+  // the lines after the first one are searched at a reduced depth, which gives a
+  // ranked list of alternative moves at a fraction of the full MultiPV cost.
+  Depth line_depth(Depth depth, size_t line) {
+    return line ? std::max(1, depth - depth * int(Options["MultiPV Reduction"]) / 100) : depth;
+  }
+
   // Add a small random component to draw evaluations to avoid 3fold-blindness
   Value value_draw(SFThread* thisThread) {
     return VALUE_DRAW + Value(2 * (thisThread->nodes & 1) - 1);
@@ -212,6 +227,98 @@ void Search::clear() {
 }
 
 
+/// Search::stats_report() formats the counters, one per line, with the hit
+/// and cutoff rates where they are more telling than the raw counts.
+
+std::string Search::stats_report(const SearchStats& stats) {
+
+  if (!HasSearchStats)
+      return "info string search statistics need a build with stats=yes";
+
+  static const char* Names[] = {
+    "PV nodes", "Non-PV nodes", "Qsearch nodes", "TT hits", "TT cutoffs",
+    "Razorings", "Futility prunes", "Null move searches", "Null move cutoffs", "ProbCut cutoffs",
+    "Moves picked", "Moves searched", "LMR searches", "LMR re-searches",
+    "Classical evals", "NNUE evals", "Material probes", "Material hits", "Pawn probes", "Pawn hits"
+  };
+
+  auto percent = [&](Counter num, uint64_t den) {
+    return den ? 100.0 * stats.counters[num] / den : 0.0;
+  };
+
+  const uint64_t* c = stats.counters;
+  uint64_t cutoffs = std::accumulate(c + Cutoffs, c + COUNTER_NB, uint64_t(0));
+  std::stringstream ss;
+
+  ss << std::fixed << std::setprecision(1);
+
+  for (int i = 0; i < Cutoffs; ++i)
+      ss << std::left << std::setw(22) << Names[i] << std::right << std::setw(14) << c[i] << "\n";
+
+  for (int i = Cutoffs; i < COUNTER_NB; ++i)
+      ss << "Cutoffs at move " << std::left << std::setw(6)
+         << std::to_string(i - Cutoffs + 1) + (i == COUNTER_NB - 1 ? "+" : "")
+         << std::right << std::setw(14) << c[i]
+         << std::setw(8) << percent(Counter(i), cutoffs) << "%\n";
+
+  uint64_t nodes = c[PvNodes] + c[NonPvNodes] + c[QsearchNodes];
+
+  ss << "TT hit rate           " << std::setw(14) << percent(TtHits, nodes) << "%\n"
+     << "LMR re-search rate    " << std::setw(14) << percent(LmrResearches, c[LmrSearches]) << "%\n"
+     << "Material hit rate     " << std::setw(14) << percent(MaterialHits, c[MaterialProbes]) << "%\n"
+     << "Pawn hit rate         " << std::setw(14) << percent(PawnHits, c[PawnProbes]) << "%";
+
+  return ss.str();
+}
+
+
+/// ResultRing::push() stores a record, overwriting the oldest one when the ring
+/// is full, and calls the subscriber if any. Each slot is guarded by a sequence
+/// number so that readers can detect a record overwritten while being copied.
+
+void Search::ResultRing::push(const PVRecord& r) {
+
+  uint64_t n = written.load(std::memory_order_relaxed);
+  Slot& slot = slots[n % Size];
+
+  slot.seq.store(2 * n + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.record = r;
+  slot.seq.store(2 * n + 2, std::memory_order_release);
+  written.store(n + 1, std::memory_order_release);
+
+  if (subscriber)
+      subscriber(r);
+}
+
+
+/// ResultRing::poll() copies the record at the given cursor, if already pushed,
+/// and advances the cursor. Records overwritten before being read are skipped.
+/// Returns false when there is no new record.
+
+bool Search::ResultRing::poll(uint64_t& cursor, PVRecord& r) const {
+
+  while (true)
+  {
+      uint64_t w = head();
+
+      if (cursor >= w)
+          return false;
+
+      cursor = std::max(cursor, w > Size ? w - Size : 0);
+
+      const Slot& slot = slots[cursor % Size];
+      uint64_t seq = slot.seq.load(std::memory_order_acquire);
+      r = slot.record;
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      // Skip the record if it has been overwritten by a newer one meanwhile
+      if (seq == 2 * cursor++ + 2 && slot.seq.load(std::memory_order_relaxed) == seq)
+          return true;
+  }
+}
+
+
 /// MainThread::search() is started when the program receives the UCI 'go'
 /// command. It searches from the root position and outputs the "bestmove".
 
@@ -230,6 +337,8 @@ void MainThread::search() {
 
   Eval::NNUE::verify();
 
+  Move bookMove = MOVE_NONE;
+
   if (rootMoves.empty())
   {
       rootMoves.emplace_back(MOVE_NONE);
@@ -239,8 +348,6 @@ void MainThread::search() {
   }
   else
   {
-      Move bookMove = MOVE_NONE;
-
       if (Options["OwnBook"] && !Limits.infinite && !Limits.mate)
       {
           bookMove = polybook.probe(rootPos);
@@ -258,13 +365,35 @@ void MainThread::search() {
           }
       }
 
-      if (bookMove && std::count(rootMoves.begin(), rootMoves.end(), bookMove))
+      // A position analyzed in advance is answered with the stored lines,
+      // reported as if just searched, unless the strength is limited. The
+      // stored scores know nothing of the game history, so positions near the
+      // fifty-move rule or with a repetition behind them are searched.
+      if (   !bookMove
+          && analysisdb.enabled()
+          && rootPos.rule50_count() < 80
+          && !rootPos.has_repeated()
+          && !Limits.infinite
+          && !Limits.mate
+          && !(Skill(Options["Skill Level"]).enabled() || int(Options["UCI_LimitStrength"])))
       {
-          for (SFThread* th : Threads)
-              std::swap(th->rootMoves[0], *std::find(th->rootMoves.begin(), th->rootMoves.end(), bookMove));
+          Depth d = analysisdb.probe(rootPos, rootMoves, std::max(Depth(Options["Analysis Min Depth"]), Limits.depth));
+
+          if (d)
+          {
+              completedDepth = d;
+              bookMove = rootMoves[0].pv[0];
+              sync_cout << UCI::pv(rootPos, d, -VALUE_INFINITE, VALUE_INFINITE) << sync_endl;
+          }
       }
+
+      // Helper threads are not started when playing a book move, so their
+      // root moves are not set up and only the main thread is updated.
+      if (bookMove && std::count(rootMoves.begin(), rootMoves.end(), bookMove))
+          std::swap(rootMoves[0], *std::find(rootMoves.begin(), rootMoves.end(), bookMove));
       else
       {
+          bookMove = MOVE_NONE;
           Threads.start_searching(); // start non-main threads
           SFThread::search();          // main thread start searching
       }
@@ -296,6 +425,7 @@ void MainThread::search() {
   if (   int(Options["MultiPV"]) == 1
       && !Limits.depth
       && !(Skill(Options["Skill Level"]).enabled() || int(Options["UCI_LimitStrength"]))
+      && !bookMove
       && rootMoves[0].pv[0] != MOVE_NONE)
       bestThread = Threads.get_best_thread();
 
@@ -353,8 +483,13 @@ void SFThread::search() {
               mainThread->iterValue[i] = mainThread->bestPreviousScore;
   }
 
-  std::copy(&lowPlyHistory[2][0], &lowPlyHistory.back().back() + 1, &lowPlyHistory[0][0]);
-  std::fill(&lowPlyHistory[MAX_LPH - 2][0], &lowPlyHistory.back().back() + 1, 0);
+  // Shift the low ply history by the two plies played since the last search,
+  // unless it was restored for this root by a resume.
+  if (!Limits.startDepth)
+  {
+      std::copy(&lowPlyHistory[2][0], &lowPlyHistory.back().back() + 1, &lowPlyHistory[0][0]);
+      std::fill(&lowPlyHistory[MAX_LPH - 2][0], &lowPlyHistory.back().back() + 1, 0);
+  }
 
   size_t multiPV = size_t(Options["MultiPV"]);
 
@@ -379,6 +514,11 @@ void SFThread::search() {
   multiPV = std::min(multiPV, rootMoves.size());
   ttHitAverage = TtHitAverageWindow * TtHitAverageResolution / 2;
 
+  // Helper threads diversity schedules, see "SMP Depth Skip" and "SMP Root Split"
+  bool skipDepths = idx && Options["SMP Depth Skip"] == "Classic";
+  bool rotateRoot = idx && Options["SMP Root Split"] == "Rotate" && multiPV == 1;
+  rotatedBest = MOVE_NONE;
+
   int ct = int(Options["Contempt"]) * PawnValueEg / 100; // From centipawns
 
   // In analysis mode, adjust contempt in accordance with user preference
@@ -394,20 +534,56 @@ void SFThread::search() {
                           : -make_score(ct, ct / 2));
 
   int searchAgainCounter = 0;
+  bool resumedScores = rootDepth > 0; // Set by start_thinking() for the first iteration
 
   // Iterative deepening loop until requested to stop or the target depth is reached
   while (   ++rootDepth < MAX_PLY
          && !Threads.stop
          && !(Limits.depth && mainThread && rootDepth > Limits.depth))
   {
+      // Distribute search depths across the helper threads
+      if (skipDepths)
+      {
+          int i = (idx - 1) % 20;
+          if (((rootDepth + rootPos.game_ply() + SkipPhase[i]) / SkipSize[i]) % 2)
+              continue;
+      }
+
       // Age out PV variability metric
       if (mainThread)
           totBestMoveChanges /= 2;
 
       // Save the last iteration's scores before first PV line is searched and
       // all the move scores except the (new) PV are set to -VALUE_INFINITE.
-      for (RootMove& rm : rootMoves)
-          rm.previousScore = rm.score;
+      if (!resumedScores)
+          for (RootMove& rm : rootMoves)
+              rm.previousScore = rm.score;
+
+      resumedScores = false;
+
+      // Let each helper start the iteration from a different one of the first
+      // root moves (of the same TB rank), so that its tree diverges from the
+      // main thread's one. The aspiration window is centered on the score of
+      // the previous best move if the rotated one has no score of its own.
+      rotatedBest = MOVE_NONE;
+
+      if (rotateRoot && rootDepth > 1)
+      {
+          size_t k = 1;
+          while (   k < std::min(rootMoves.size(), size_t(4))
+                 && rootMoves[k].tbRank == rootMoves[0].tbRank)
+              ++k;
+
+          if (size_t r = idx % k)
+          {
+              Value prev = rootMoves[0].previousScore;
+              rotatedBest = rootMoves[0].pv[0];
+              std::rotate(rootMoves.begin(), rootMoves.begin() + r, rootMoves.begin() + r + 1);
+
+              if (rootMoves[0].previousScore == -VALUE_INFINITE)
+                  rootMoves[0].previousScore = prev;
+          }
+      }
 
       size_t pvFirst = 0;
       pvLast = 0;
@@ -450,7 +626,7 @@ void SFThread::search() {
           failedHighCnt = 0;
           while (true)
           {
-              Depth adjustedDepth = std::max(1, rootDepth - failedHighCnt - searchAgainCounter);
+              Depth adjustedDepth = std::max(1, line_depth(rootDepth, pvIdx) - failedHighCnt - searchAgainCounter);
               bestValue = ::search<PV>(rootPos, ss, alpha, beta, adjustedDepth, false);
 
               // Bring the best move to the front. It is critical that sorting
@@ -499,8 +675,10 @@ void SFThread::search() {
               assert(alpha >= -VALUE_INFINITE && beta <= VALUE_INFINITE);
           }
 
-          // Sort the PV lines searched so far and update the GUI
-          std::stable_sort(rootMoves.begin() + pvFirst, rootMoves.begin() + pvIdx + 1);
+          // Sort the PV lines searched so far and update the GUI. Lines searched
+          // at a reduced depth never overtake the first one.
+          size_t sortFirst = std::max(pvFirst, size_t(line_depth(rootDepth, 1) < rootDepth));
+          std::stable_sort(rootMoves.begin() + sortFirst, rootMoves.begin() + pvIdx + 1);
 
           if (    mainThread
               && (Threads.stop || pvIdx + 1 == multiPV || Time.elapsed() > 3000))
@@ -645,6 +823,7 @@ namespace {
     moveCount = captureCount = quietCount = ss->moveCount = 0;
     bestValue = -VALUE_INFINITE;
     maxValue = VALUE_INFINITE;
+    thisThread->stats.inc(PvNode ? PvNodes : NonPvNodes);
 
     // Check for the available remaining time
     if (thisThread == Threads.main())
@@ -704,6 +883,9 @@ namespace {
         ss->ttPv = PvNode || (ss->ttHit && tte->is_pv());
     formerPv = ss->ttPv && !PvNode;
 
+    if (ss->ttHit)
+        thisThread->stats.inc(TtHits);
+
     if (   ss->ttPv
         && depth > 12
         && ss->ply - 1 < MAX_LPH
@@ -745,7 +927,10 @@ namespace {
         }
 
         if (pos.rule50_count() < 90)
+        {
+            thisThread->stats.inc(TtCutoffs);
             return ttValue;
+        }
     }
 
     // Step 5. Tablebases probe
@@ -839,7 +1024,10 @@ namespace {
     if (   !rootNode // The required rootNode PV handling is not available in qsearch
         &&  depth == 1
         &&  eval <= alpha - RazorMargin)
+    {
+        thisThread->stats.inc(Razorings);
         return qsearch<NT>(pos, ss, alpha, beta);
+    }
 
     improving =  (ss-2)->staticEval == VALUE_NONE
                ? ss->staticEval > (ss-4)->staticEval || (ss-4)->staticEval == VALUE_NONE
@@ -850,7 +1038,10 @@ namespace {
         &&  depth < 8
         &&  eval - futility_margin(depth, improving) >= beta
         &&  eval < VALUE_KNOWN_WIN) // Do not return unproven wins
+    {
+        thisThread->stats.inc(FutilityPrunes);
         return eval;
+    }
 
     // Step 9. Null move search with verification search (~40 Elo)
     if (   !PvNode
@@ -864,6 +1055,7 @@ namespace {
         && (ss->ply >= thisThread->nmpMinPly || us != thisThread->nmpColor))
     {
         assert(eval - beta >= 0);
+        thisThread->stats.inc(NullMoveSearches);
 
         // Null move dynamic reduction based on depth and value
         Depth R = (982 + 85 * depth) / 256 + std::min(int(eval - beta) / 192, 3);
@@ -879,6 +1071,8 @@ namespace {
 
         if (nullValue >= beta)
         {
+            thisThread->stats.inc(NullMoveCutoffs);
+
             // Do not return unproven mate or TB scores
             if (nullValue >= VALUE_TB_WIN_IN_MAX_PLY)
                 nullValue = beta;
@@ -927,7 +1121,10 @@ namespace {
             && ttValue >= probCutBeta
             && ttMove
             && pos.capture_or_promotion(ttMove))
+        {
+            thisThread->stats.inc(ProbCutCutoffs);
             return probCutBeta;
+        }
 
         assert(probCutBeta < VALUE_INFINITE);
         MovePicker mp(pos, ttMove, probCutBeta - ss->staticEval, &captureHistory);
@@ -971,6 +1168,7 @@ namespace {
                         tte->save(posKey, value_to_tt(value, ss->ply), ttPv,
                             BOUND_LOWER,
                             depth - 3, move, ss->staticEval);
+                    thisThread->stats.inc(ProbCutCutoffs);
                     return value;
                 }
             }
@@ -1028,6 +1226,7 @@ moves_loop: // When in check, search starts from here
           continue;
 
       ss->moveCount = ++moveCount;
+      thisThread->stats.inc(MovesPicked);
 
       if (rootNode && thisThread == Threads.main() && Time.elapsed() > 3000)
           sync_cout << "info depth " << depth
@@ -1172,6 +1371,7 @@ moves_loop: // When in check, search starts from here
 
       // Step 15. Make the move
       pos.do_move(move, st, givesCheck);
+      thisThread->stats.inc(MovesSearched);
 
       // Step 16. Reduced depth search (LMR, ~200 Elo). If the move fails high it will be
       // re-searched at full depth.
@@ -1263,8 +1463,11 @@ moves_loop: // When in check, search starts from here
           Depth d = std::clamp(newDepth - r, 1, newDepth);
 
           value = -search<NonPV>(pos, ss+1, -(alpha+1), -alpha, d, true);
+          thisThread->stats.inc(LmrSearches);
 
           doFullDepthSearch = value > alpha && d != newDepth;
+          if (doFullDepthSearch)
+              thisThread->stats.inc(LmrResearches);
 
           didLMR = true;
       }
@@ -1336,7 +1539,9 @@ moves_loop: // When in check, search starts from here
               // We record how often the best move has been changed in each
               // iteration. This information is used for time management: when
               // the best move changes frequently, we allocate some more time.
-              if (moveCount > 1)
+              // A move regaining the first place after a root rotation is not
+              // a change.
+              if (moveCount > 1 && move != thisThread->rotatedBest)
                   ++thisThread->bestMoveChanges;
           }
           else
@@ -1363,6 +1568,7 @@ moves_loop: // When in check, search starts from here
               {
                   assert(value >= beta); // Fail high
                   ss->statScore = 0;
+                  thisThread->stats.inc(Counter(Cutoffs + std::min(moveCount, COUNTER_NB - Cutoffs) - 1));
                   break;
               }
           }
@@ -1465,6 +1671,7 @@ moves_loop: // When in check, search starts from here
     bestMove = MOVE_NONE;
     ss->inCheck = pos.checkers();
     moveCount = 0;
+    thisThread->stats.inc(QsearchNodes);
 
     // Check for an immediate draw or maximum ply reached
     if (   pos.is_draw(ss->ply)
@@ -1485,13 +1692,19 @@ moves_loop: // When in check, search starts from here
     ttMove = ss->ttHit ? tte->move() : MOVE_NONE;
     pvHit = ss->ttHit && tte->is_pv();
 
+    if (ss->ttHit)
+        thisThread->stats.inc(TtHits);
+
     if (  !PvNode
         && ss->ttHit
         && tte->depth() >= ttDepth
         && ttValue != VALUE_NONE // Only in case of TT access race
         && (ttValue >= beta ? (tte->bound() & BOUND_LOWER)
                             : (tte->bound() & BOUND_UPPER)))
+    {
+        thisThread->stats.inc(TtCutoffs);
         return ttValue;
+    }
 
     // Evaluate the position statically
     if (ss->inCheck)
@@ -1872,6 +2085,8 @@ void MainThread::check_time() {
 
 /// UCI::pv() formats PV information according to the UCI protocol. UCI requires
 /// that all (if any) unsearched PV lines are sent using a previous search score.
+/// Each line is also published as a PVRecord into the main thread's result ring,
+/// and the text is not built at all when the output is muted.
 
 string UCI::pv(const Position& pos, Depth depth, Value alpha, Value beta) {
 
@@ -1882,6 +2097,7 @@ string UCI::pv(const Position& pos, Depth depth, Value alpha, Value beta) {
   size_t multiPV = std::min((size_t)Options["MultiPV"], rootMoves.size());
   uint64_t nodesSearched = Threads.nodes_searched();
   uint64_t tbHits = Threads.tb_hits() + (TB::RootInTB ? rootMoves.size() : 0);
+  Search::PVRecord r;
 
   for (size_t i = 0; i < multiPV; ++i)
   {
@@ -1890,7 +2106,7 @@ string UCI::pv(const Position& pos, Depth depth, Value alpha, Value beta) {
       if (depth == 1 && !updated && i > 0)
           continue;
 
-      Depth d = updated ? depth : std::max(1, depth - 1);
+      Depth d = line_depth(updated ? depth : std::max(1, depth - 1), i);
       Value v = updated ? rootMoves[i].score : rootMoves[i].previousScore;
 
       if (v == -VALUE_INFINITE)
@@ -1899,20 +2115,35 @@ string UCI::pv(const Position& pos, Depth depth, Value alpha, Value beta) {
       bool tb = TB::RootInTB && abs(v) < VALUE_MATE_IN_MAX_PLY;
       v = tb ? rootMoves[i].tbScore : v;
 
+      r.nodes    = nodesSearched;
+      r.tbHits   = tbHits;
+      r.time     = elapsed;
+      r.score    = v;
+      r.bound    = tb || i != pvIdx ? BOUND_EXACT : v >= beta ? BOUND_LOWER : v <= alpha ? BOUND_UPPER : BOUND_EXACT;
+      r.depth    = d;
+      r.selDepth = rootMoves[i].selDepth;
+      r.multiPV  = int(i + 1);
+      r.pvLength = int(std::min(rootMoves[i].pv.size(), size_t(Search::PVRecord::MaxPV)));
+      std::copy(rootMoves[i].pv.begin(), rootMoves[i].pv.begin() + r.pvLength, r.pv);
+
+      Threads.main()->results.push(r);
+
+      if (!std::cout) // Muted, as in the embedding
+          continue;
+
       if (ss.rdbuf()->in_avail()) // Not at first line
           ss << "\n";
 
       ss << "info"
          << " depth "    << d
-         << " seldepth " << rootMoves[i].selDepth
-         << " multipv "  << i + 1
+         << " seldepth " << r.selDepth
+         << " multipv "  << r.multiPV
          << " score "    << UCI::value(v);
 
       if (Options["UCI_ShowWDL"])
           ss << UCI::wdl(v, pos.game_ply());
 
-      if (!tb && i == pvIdx)
-          ss << (v >= beta ? " lowerbound" : v <= alpha ? " upperbound" : "");
+      ss << (r.bound == BOUND_LOWER ? " lowerbound" : r.bound == BOUND_UPPER ? " upperbound" : "");
 
       ss << " nodes "    << nodesSearched
          << " nps "      << nodesSearched * 1000 / elapsed;
@@ -1926,11 +2157,6 @@ string UCI::pv(const Position& pos, Depth depth, Value alpha, Value beta) {
 
       for (Move m : rootMoves[i].pv)
           ss << " " << UCI::move(m, pos.is_chess960());
-
-      // CN
-      if(pos.this_thread()->pvCallback) {
-        pos.this_thread()->pvCallback(rootMoves[i].pv[0], d, rootMoves[i].selDepth, v);
-      }
   }
 
   return ss.str();
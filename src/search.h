@@ -19,6 +19,9 @@
 #ifndef SEARCH_H_INCLUDED
 #define SEARCH_H_INCLUDED
 
+#include <atomic>
+#include <functional>
+#include <string>
 #include <vector>
 
 #include "misc.h"
@@ -78,6 +81,58 @@ struct RootMove {
 typedef std::vector<RootMove> RootMoves;
 
 
+/// PVRecord struct is the structured form of an "info ... pv" line. The main
+/// thread publishes one record per PV line into its ResultRing each time it
+/// reports the PV lines, so that callers get the search results without any
+/// text formatting or parsing.
+
+struct PVRecord {
+
+  static constexpr int MaxPV = 32;
+
+  Move move() const { return pv[0]; }
+
+  uint64_t nodes;
+  uint64_t tbHits;
+  TimePoint time;
+  Value score;
+  Bound bound;    // BOUND_EXACT, or the bound set by a fail high/low
+  Depth depth;
+  int selDepth;
+  int multiPV;    // Index of the line, starting from 1
+  int pvLength;   // Number of moves in pv[], at most MaxPV
+  Move pv[MaxPV];
+};
+
+
+/// ResultRing class is a fixed-size ring of PVRecords with a single producer,
+/// the main search thread, which pushes without locking or allocating. Readers
+/// either subscribe, getting called on the search thread after each push, or
+/// poll with their own cursor from any thread. A reader falling more than Size
+/// records behind skips the overwritten ones.
+
+class ResultRing {
+
+public:
+  static constexpr uint64_t Size = 64;
+
+  void push(const PVRecord& r);
+  bool poll(uint64_t& cursor, PVRecord& r) const;
+  uint64_t head() const { return written.load(std::memory_order_acquire); }
+
+  std::function<void(const PVRecord&)> subscriber;
+
+private:
+  struct Slot {
+    std::atomic<uint64_t> seq { 0 }; // 2n + 1 while writing record n, 2n + 2 once done
+    PVRecord record;
+  };
+
+  Slot slots[Size];
+  std::atomic<uint64_t> written { 0 };
+};
+
+
 /// LimitsType struct stores information sent by GUI about available time to
 /// search the current move, maximum depth/time, or if we are in analysis mode.
 
@@ -85,7 +140,7 @@ struct LimitsType {
 
   LimitsType() { // Init explicitly due to broken value-initialization of non POD in MSVC
     time[WHITE] = time[BLACK] = inc[WHITE] = inc[BLACK] = npmsec = movetime = TimePoint(0);
-    movestogo = depth = mate = perft = infinite = 0;
+    movestogo = depth = mate = perft = infinite = startDepth = 0;
     nodes = 0;
   }
 
@@ -94,13 +149,48 @@ struct LimitsType {
   }
 
   std::vector<Move> searchmoves;
+  std::vector<Move> rootPV; // Expected PV, e.g. from the search of an earlier move
+  RootMoves rootLines;      // Ranked lines of a resumed search, searched to startDepth
   TimePoint time[COLOR_NB], inc[COLOR_NB], npmsec, movetime, startTime;
-  int movestogo, depth, mate, perft, infinite;
+  int movestogo, depth, mate, perft, infinite, startDepth;
   int64_t nodes;
 };
 
 extern LimitsType Limits;
 
+
+/// Counter enumerates the search events counted in builds with -DSEARCH_STATS.
+/// Cutoffs is followed by one slot per move number of the beta cutoff, the
+/// last slot also counts the later moves.
+
+enum Counter {
+  PvNodes, NonPvNodes, QsearchNodes, TtHits, TtCutoffs,
+  Razorings, FutilityPrunes, NullMoveSearches, NullMoveCutoffs, ProbCutCutoffs,
+  MovesPicked, MovesSearched, LmrSearches, LmrResearches,
+  EvalClassical, EvalNnue, MaterialProbes, MaterialHits, PawnProbes, PawnHits,
+  Cutoffs, COUNTER_NB = Cutoffs + 8
+};
+
+/// SearchStats holds the counters of one thread. Only the owning thread
+/// writes them, so they are plain integers; without -DSEARCH_STATS inc() is
+/// empty and the counting compiles away.
+
+struct SearchStats {
+
+  void inc(Counter c) { if (HasSearchStats) ++counters[c]; }
+  void clear() { std::fill(std::begin(counters), std::end(counters), 0); }
+
+  SearchStats& operator+=(const SearchStats& s) {
+    for (int c = 0; c < COUNTER_NB; ++c)
+        counters[c] += s.counters[c];
+    return *this;
+  }
+
+  uint64_t counters[COUNTER_NB];
+};
+
+std::string stats_report(const SearchStats& stats);
+
 void init();
 void clear();
 
@@ -0,0 +1,756 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2020 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "misc.h"
+#include "position.h"
+#include "search.h"
+#include "server.h"
+#include "thread.h"
+#include "uci.h"
+
+using namespace std;
+
+#ifdef _WIN32
+
+bool Server::run(const string&, bool) {
+  sync_cout << "info string server mode needs Unix domain sockets" << sync_endl;
+  return false;
+}
+
+bool Server::fork_workers(const string&, bool) {
+  sync_cout << "info string fork server mode needs fork() and Unix domain sockets" << sync_endl;
+  return false;
+}
+
+#else
+
+namespace {
+
+  // The poll loop is woken through this pipe when output is queued or a
+  // session is closed from another thread.
+  int wakeFds[2] = { -1, -1 };
+
+  void wake() { ssize_t n = write(wakeFds[1], "", 1); (void)n; }
+
+  // Output not yet taken by a client, beyond which its session is dropped
+  constexpr size_t MaxOutput = 1 << 20;
+
+
+  /// Session struct holds one game served over a connection: the position to
+  /// search from and the limits of its pending search, if any. The socket is
+  /// non-blocking and closed with the last reference, so that a search still
+  /// running for a dropped session never writes to a reused descriptor.
+
+  struct Session {
+
+    explicit Session(int s) : fd(s) { fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK); }
+    ~Session() { close(fd); }
+
+    void send(const string& text);
+    void flush();
+    bool has_output() { lock_guard<mutex> lk(writeMutex); return !output.empty(); }
+
+    int fd;
+    string input;                   // Received bytes not yet forming a line
+    string output;                  // Bytes the socket did not take yet
+    string position = "startpos";   // Arguments of the last 'position' command
+    string searchPosition;          // Position of the pending search
+    Search::LimitsType limits;      // Limits of the pending search
+    bool pending = false;           // A search is queued or running
+    atomic_bool closed { false };
+    mutex writeMutex;
+
+  private:
+    void write_out();
+  };
+
+  // send() never waits for the client: what the socket does not take is queued
+  // and sent by the poll loop. A client not reading its output is dropped.
+
+  void Session::send(const string& text) {
+
+    lock_guard<mutex> lk(writeMutex);
+
+    if (closed)
+        return;
+
+    output += text;
+    write_out();
+
+    if (output.size() > MaxOutput)
+        closed = true, output.clear();
+
+    if (closed || !output.empty())
+        wake();
+  }
+
+  void Session::flush() {
+
+    lock_guard<mutex> lk(writeMutex);
+    write_out();
+  }
+
+  void Session::write_out() {
+
+    size_t done = 0;
+
+    while (!closed && done < output.size())
+    {
+        ssize_t n = ::send(fd, output.data() + done, output.size() - done, 0);
+
+        if (n > 0)
+            done += size_t(n);
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        else if (n == 0 || errno != EINTR)
+            closed = true;
+    }
+
+    output.erase(0, done);
+  }
+
+
+  /// SessionBuf collects what the search prints to std::cout and sends it to
+  /// the session owning the search, one line at a time as sync_endl flushes.
+
+  class SessionBuf : public stringbuf {
+
+  public:
+    explicit SessionBuf(Session& s) : session(s) {}
+
+  private:
+    int sync() override { session.send(str()); str(""); return 0; }
+
+    Session& session;
+  };
+
+
+  // Sessions wait in a FIFO queue, each with at most one pending search, so
+  // that the searches of busy sessions are interleaved round robin.
+  mutex queueMutex;
+  condition_variable queueCv;
+  deque<shared_ptr<Session>> queue;
+  shared_ptr<Session> running;
+  bool exiting;
+
+
+  // scheduler() runs the queued searches one after the other on the shared
+  // thread pool. The search output goes to the session that asked for it.
+
+  void scheduler() {
+
+    unique_lock<mutex> lk(queueMutex);
+
+    while (true)
+    {
+        queueCv.wait(lk, []{ return exiting || !queue.empty(); });
+
+        if (exiting)
+            return;
+
+        shared_ptr<Session> s = queue.front();
+        queue.pop_front();
+
+        Position pos;
+        StateListPtr states;
+        istringstream is(s->searchPosition);
+        UCI::position(pos, is, states);
+
+        // The requested time counts from the request, like the clock of the
+        // client, the cap from now so that a late search is not cut short.
+        TimePoint maxTime = now() - s->limits.startTime + int(Options["Server Move Time"]);
+        if (!s->limits.movetime || s->limits.movetime > maxTime)
+            s->limits.movetime = maxTime;
+
+        SessionBuf buf(*s);
+        streambuf* out = cout.rdbuf(&buf);
+
+        running = s;
+        Threads.start_thinking(pos, states, s->limits, false);
+        lk.unlock();
+
+        Threads.main()->wait_for_search_finished();
+
+        lk.lock();
+        cout.rdbuf(out);
+        running = nullptr;
+        s->pending = false;
+    }
+  }
+
+
+  // go() queues a search for the session. Searches cannot be infinite or
+  // ponder, and their run time is capped to the "Server Move Time", so that a
+  // session cannot hold the thread pool for long.
+
+  void go(const shared_ptr<Session>& s, istringstream& is) {
+
+    lock_guard<mutex> lk(queueMutex);
+
+    if (s->pending)
+    {
+        s->send("info string a search is already pending\n");
+        return;
+    }
+
+    Position pos;
+    StateListPtr states;
+    istringstream ps(s->position);
+    UCI::position(pos, ps, states);
+
+    bool ponderMode = false;
+    s->limits = UCI::limits(pos, is, ponderMode);
+    s->limits.infinite = s->limits.perft = 0;
+    s->searchPosition = s->position;
+    s->pending = true;
+    queue.push_back(s);
+    queueCv.notify_one();
+  }
+
+
+  // valid_fen() checks what Position::set() takes for granted: a full board
+  // with one king of each color, no pawns on the first or last rank, piece
+  // counts reachable in a game, a side to move and castling rooks where
+  // castling rights are given. The piece counts keep the piece lists and the
+  // move lists within their bounds.
+
+  const string PieceChars(" PNBRQK  pnbrqk"); // Indexed by Piece, as in a FEN
+
+  bool valid_fen(const string& fen) {
+
+    istringstream ss(fen);
+    string board, side, castling;
+    int count[PIECE_NB] = {}, rank = 7, file = 0;
+
+    if (!(ss >> board >> side) || (side != "w" && side != "b"))
+        return false;
+
+    for (char c : board)
+    {
+        if (c == '/')
+        {
+            if (file != 8 || --rank < 0)
+                return false;
+            file = 0;
+        }
+        else if (c >= '1' && c <= '8')
+            file += c - '0';
+
+        else if (c != ' ' && PieceChars.find(c) != string::npos)
+        {
+            if ((c == 'P' || c == 'p') && (rank == 0 || rank == 7))
+                return false;
+            ++count[PieceChars.find(c)];
+            ++file;
+        }
+        else
+            return false;
+
+        if (file > 8)
+            return false;
+    }
+
+    if (rank != 0 || file != 8)
+        return false;
+
+    for (Color c : { WHITE, BLACK })
+    {
+        int pawns = count[make_piece(c, PAWN)];
+        int pieces = 0;
+        int promoted =  std::max(count[make_piece(c, KNIGHT)] - 2, 0)
+                      + std::max(count[make_piece(c, BISHOP)] - 2, 0)
+                      + std::max(count[make_piece(c, ROOK)] - 2, 0)
+                      + std::max(count[make_piece(c, QUEEN)] - 1, 0);
+
+        for (PieceType pt = PAWN; pt <= KING; ++pt)
+            pieces += count[make_piece(c, pt)];
+
+        if (count[make_piece(c, KING)] != 1 || pawns > 8 || pieces > 16 || promoted > 8 - pawns)
+            return false;
+    }
+
+    if (!(ss >> castling) || castling == "-")
+        return true;
+
+    // The king and the castling rook must be on their first rank
+    auto firstRank = [&](Color c) {
+        size_t from = c == WHITE ? board.rfind('/') + 1 : 0;
+        return board.substr(from, board.find('/', from) - from);
+    };
+
+    for (char c : castling)
+    {
+        string r = firstRank(islower(c) ? BLACK : WHITE);
+        bool white = !islower(c);
+
+        if (   string("KQABCDEFGH").find(char(toupper(c))) == string::npos
+            || r.find(white ? 'K' : 'k') == string::npos
+            || r.find(white ? 'R' : 'r') == string::npos)
+            return false;
+    }
+
+    return true;
+  }
+
+
+  // valid_position() returns whether the arguments of a 'position' command
+  // give a position that can be searched safely, the side not to move not
+  // being in check.
+
+  bool valid_position(const string& args) {
+
+    istringstream is(args);
+    string token, fen;
+
+    is >> token;
+
+    if (token == "fen")
+    {
+        while (is >> token && token != "moves")
+            fen += token + " ";
+
+        if (!valid_fen(fen))
+            return false;
+    }
+    else if (token != "startpos")
+        return false;
+
+    Position pos;
+    StateListPtr states;
+    istringstream ps(args);
+    UCI::position(pos, ps, states);
+
+    return !(pos.attackers_to(pos.square<KING>(~pos.side_to_move())) & pos.pieces(pos.side_to_move()));
+  }
+
+
+  // command() handles one line of a session. Returns false on 'quit'.
+
+  bool command(const shared_ptr<Session>& s, const string& cmd) {
+
+    istringstream is(cmd);
+    string token;
+
+    is >> skipws >> token;
+
+    if (token == "uci")
+        s->send("id name " + engine_info(true) + "\nuciok\n");
+
+    else if (token == "isready")
+        s->send("readyok\n");
+
+    else if (token == "ucinewgame")
+        s->position = "startpos";
+
+    else if (token == "position")
+    {
+        string args;
+        getline(is >> ws, args);
+
+        if (valid_position(args))
+            s->position = args;
+        else
+            s->send("info string invalid position\n");
+    }
+    else if (token == "go")
+        go(s, is);
+
+    else if (token == "stop")
+    {
+        // A queued search is cut to depth 1 to answer at once
+        lock_guard<mutex> lk(queueMutex);
+        if (running == s)
+            Threads.stop = true;
+        else if (s->pending)
+            s->limits.depth = 1;
+    }
+    else if (token == "quit")
+        return false;
+
+    else if (!token.empty())
+        s->send("info string unsupported command: " + token + "\n");
+
+    return true;
+  }
+
+
+  // listen_on() returns a socket listening at the given path, or -1
+
+  int listen_on(const string& path) {
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+    {
+        sync_cout << "info string invalid server socket path '" << path << "'" << sync_endl;
+        return -1;
+    }
+
+    strcpy(addr.sun_path, path.c_str());
+    unlink(path.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (   listener < 0
+        || bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+        || listen(listener, 64) < 0)
+    {
+        sync_cout << "info string cannot listen on " << path << ": " << strerror(errno) << sync_endl;
+        if (listener >= 0)
+            close(listener);
+        return -1;
+    }
+
+    return listener;
+  }
+
+
+  // console_quit() reads what is available on the console. Returns true on
+  // a "quit" line or at the end of input.
+
+  bool console_quit(string& input) {
+
+    char buf[256];
+    ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+
+    if (n <= 0)
+        return true;
+
+    input.append(buf, size_t(n));
+
+    for (size_t eol; (eol = input.find('\n')) != string::npos; )
+    {
+        istringstream is(input.substr(0, eol));
+        string token, rest;
+        input.erase(0, eol + 1);
+
+        if (is >> token && token == "quit" && !(is >> rest))
+            return true;
+    }
+
+    return false;
+  }
+
+
+  /// FdBuf class is a buffered stream over a socket, the std::cin and std::cout
+  /// of a forked worker.
+
+  class FdBuf : public streambuf {
+
+  public:
+    explicit FdBuf(int s) : fd(s) { setg(in, in, in); setp(out, out + sizeof(out)); }
+
+  private:
+    int underflow() override {
+      ssize_t n = read(fd, in, sizeof(in));
+      if (n <= 0)
+          return traits_type::eof();
+      setg(in, in, in + n);
+      return traits_type::to_int_type(*gptr());
+    }
+
+    int overflow(int c) override {
+      if (sync() < 0)
+          return traits_type::eof();
+      if (c != traits_type::eof())
+          *pptr() = char(c), pbump(1);
+      return traits_type::not_eof(c);
+    }
+
+    int sync() override {
+      for (char* p = pbase(); p < pptr(); )
+      {
+          ssize_t n = write(fd, p, size_t(pptr() - p));
+          if (n <= 0)
+              return -1;
+          p += n;
+      }
+      setp(out, out + sizeof(out));
+      return 0;
+    }
+
+    int fd;
+    char in[4096], out[4096];
+  };
+
+
+  // worker() runs in a forked child: a plain UCI engine over the connection,
+  // with its own thread pool and hash table. Everything set up before the fork
+  // (magics, bitbases, endgames, network weights, book) is shared with the
+  // parent until written to. Thread binding is turned off, as every worker
+  // would bind its pool to the first node; the system spreads the workers.
+
+  [[noreturn]] void worker(int fd) {
+
+    signal(SIGCHLD, SIG_DFL);
+
+    FdBuf buf(fd);
+    cin.rdbuf(&buf);
+    cout.rdbuf(&buf);
+
+    Options["Thread Binding"] = string("Off"); // Starts the thread pool
+    UCI::loop(1, nullptr);
+    Threads.set(0);
+
+    cout.flush();
+    _exit(0);
+  }
+
+
+  // drop() forgets a session: its queued search is dropped, a running one
+  // is stopped.
+
+  void drop(const shared_ptr<Session>& s) {
+
+    lock_guard<mutex> lk(queueMutex);
+
+    s->closed = true;
+    queue.erase(remove(queue.begin(), queue.end(), s), queue.end());
+
+    if (running == s)
+        Threads.stop = true;
+  }
+
+} // namespace
+
+
+/// Server::run() listens on a Unix domain socket at the given path and serves
+/// the sessions until "quit" is read from the console, if any. Returns false
+/// if it could not listen.
+
+bool Server::run(const string& path, bool console) {
+
+  int listener = listen_on(path);
+
+  if (listener < 0)
+      return false;
+
+  signal(SIGPIPE, SIG_IGN); // Dropped clients are noticed by send() and recv()
+
+  if (pipe(wakeFds) < 0)
+  {
+      sync_cout << "info string cannot create pipe: " << strerror(errno) << sync_endl;
+      close(listener);
+      return false;
+  }
+
+  fcntl(wakeFds[0], F_SETFL, O_NONBLOCK);
+  fcntl(wakeFds[1], F_SETFL, O_NONBLOCK);
+
+  // Nothing but the search writes to std::cout from now on
+  sync_cout << "info string serving on " << path << sync_endl;
+
+  exiting = false;
+  thread worker(scheduler);
+  vector<shared_ptr<Session>> sessions;
+  string consoleInput;
+  char buf[4096];
+  bool quit = false;
+
+  while (!quit)
+  {
+      vector<pollfd> fds = { { listener, POLLIN, 0 },
+                             { console ? STDIN_FILENO : -1, POLLIN, 0 },
+                             { wakeFds[0], POLLIN, 0 } };
+
+      for (auto& s : sessions)
+          fds.push_back({ s->fd, short(POLLIN | (s->has_output() ? POLLOUT : 0)), 0 });
+
+      if (poll(fds.data(), fds.size(), -1) < 0)
+      {
+          if (errno == EINTR)
+              continue;
+          break;
+      }
+
+      if (fds[0].revents & POLLIN)
+      {
+          int fd = accept(listener, nullptr, nullptr);
+
+          if (fd >= 0)
+          {
+              auto s = make_shared<Session>(fd);
+
+              if (sessions.size() < size_t(int(Options["Server Sessions"])))
+                  sessions.push_back(s);
+              else
+                  s->send("info string too many sessions\n");
+          }
+      }
+
+      if (fds[1].revents)
+          quit = console_quit(consoleInput);
+
+      if (fds[2].revents)
+          while (read(wakeFds[0], buf, sizeof(buf)) > 0) {}
+
+      for (size_t i = 0; i < sessions.size(); ++i)
+      {
+          auto& s = sessions[i];
+          short events = fds[i + 3].revents;
+
+          if (events & POLLOUT)
+              s->flush();
+
+          if (!(events & ~POLLOUT))
+              continue;
+
+          ssize_t n = recv(s->fd, buf, sizeof(buf), 0);
+
+          if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+              continue;
+
+          if (n <= 0)
+          {
+              drop(s);
+              continue;
+          }
+
+          s->input.append(buf, size_t(n));
+
+          for (size_t eol; !s->closed && (eol = s->input.find('\n')) != string::npos; )
+          {
+              string cmd = s->input.substr(0, eol);
+              s->input.erase(0, eol + 1);
+
+              if (!cmd.empty() && cmd.back() == '\r')
+                  cmd.pop_back();
+
+              if (!command(s, cmd))
+                  drop(s);
+          }
+      }
+
+      // Sessions closed by a failed or overflowing send are dropped here
+      sessions.erase(remove_if(sessions.begin(), sessions.end(),
+                               [](const shared_ptr<Session>& s) {
+                                   if (s->closed)
+                                       drop(s);
+                                   return bool(s->closed);
+                               }),
+                     sessions.end());
+  }
+
+  {
+      lock_guard<mutex> lk(queueMutex);
+      exiting = true;
+      queue.clear();
+      if (running)
+          Threads.stop = true;
+  }
+
+  queueCv.notify_one();
+  worker.join();
+  Threads.main()->wait_for_search_finished();
+
+  close(wakeFds[0]);
+  close(wakeFds[1]);
+  close(listener);
+  unlink(path.c_str());
+  return true;
+}
+
+
+/// Server::fork_workers() listens on a Unix domain socket at the given path and
+/// forks a worker engine for each connection, until "quit" is read from the
+/// console, if any. Returns false if it could not listen.
+
+bool Server::fork_workers(const string& path, bool console) {
+
+  int listener = listen_on(path);
+
+  if (listener < 0)
+      return false;
+
+  // Only the forking thread lives on in a child, so the pool is stopped here
+  // and each worker starts its own.
+  Threads.set(0);
+  signal(SIGCHLD, SIG_IGN); // Let the system reap the workers
+
+  sync_cout << "info string forking workers on " << path << sync_endl;
+
+  string consoleInput;
+  bool quit = false;
+
+  while (!quit)
+  {
+      pollfd fds[] = { { listener, POLLIN, 0 }, { console ? STDIN_FILENO : -1, POLLIN, 0 } };
+
+      if (poll(fds, 2, -1) < 0)
+      {
+          if (errno == EINTR)
+              continue;
+          break;
+      }
+
+      if (fds[1].revents)
+          quit = console_quit(consoleInput);
+
+      if (fds[0].revents & POLLIN)
+      {
+          int fd = accept(listener, nullptr, nullptr);
+
+          if (fd < 0)
+              continue;
+
+          cout.flush(); // Not to be written again by the worker
+          pid_t pid = fork();
+
+          if (pid == 0)
+          {
+              close(listener);
+              worker(fd);
+          }
+
+          close(fd);
+
+          if (pid < 0)
+              sync_cout << "info string fork failed: " << strerror(errno) << sync_endl;
+      }
+  }
+
+  close(listener);
+  unlink(path.c_str());
+  return true;
+}
+
+#endif
@@ -0,0 +1,43 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2020 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SERVER_H_INCLUDED
+#define SERVER_H_INCLUDED
+
+#include <string>
+
+namespace Server {
+
+/// Server::run() serves many games over a local socket. Each connection is a
+/// game session speaking a subset of UCI, one command per line. The searches
+/// of all sessions share the thread pool and the hash table and run one at a
+/// time, in the order they were asked for. Returns on "quit" from the console,
+/// when there is one, or false at once if the socket cannot be set up.
+
+bool run(const std::string& path, bool console);
+
+/// Server::fork_workers() forks a worker engine for each connection instead,
+/// after everything read-only is initialized: workers share those pages with
+/// the parent and are ready in milliseconds. A worker is a plain UCI engine
+/// with its own threads and hash table, ending with its connection.
+
+bool fork_workers(const std::string& path, bool console);
+
+} // namespace Server
+
+#endif // #ifndef SERVER_H_INCLUDED
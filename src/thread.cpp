@@ -32,7 +32,19 @@ SFThreadPool Threads; // Global object
 /// SFThread constructor launches the thread and waits until it goes to sleep
 /// in idle_loop(). Note that 'searching' and 'exit' should be already set.
 
-SFThread::SFThread(size_t n) : idx(n), stdThread(&SFThread::idle_loop, this) {
+SFThread::SFThread(size_t n, ContinuationHistory (*sharedContinuationHistory)[2])
+  : idx(n), stdThread(&SFThread::idle_loop, this) {
+
+  // Continuation histories are the bulk of the thread's memory, so helpers may
+  // share the ones of the main thread instead of owning a copy. The idle thread
+  // does not touch them before the first clear() or search.
+  if (sharedContinuationHistory)
+      continuationHistory = sharedContinuationHistory;
+  else
+  {
+      ownContinuationHistory.reset(new ContinuationHistory[2][2]);
+      continuationHistory = ownContinuationHistory.get();
+  }
 
   wait_for_search_finished();
 }
@@ -59,6 +71,10 @@ void SFThread::clear() {
   mainHistory.fill(0);
   lowPlyHistory.fill(0);
   captureHistory.fill(0);
+  stats.clear();
+
+  if (!ownContinuationHistory) // Cleared by its owner
+      return;
 
   for (bool inCheck : { false, true })
       for (StatsType c : { NoCaptures, Captures })
@@ -71,50 +87,105 @@ void SFThread::clear() {
 }
 
 
+namespace {
+
+  // Hint to the CPU that we are in a spin-wait loop
+  inline void cpu_pause() {
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+      __builtin_ia32_pause();
+#endif
+  }
+
+} // namespace
+
+
+/// SFThread::wait_until() blocks until 'searching' reaches the given state.
+/// The wait is hybrid: we first spin for Threads.spinTime microseconds, which
+/// gives the lowest latency for back to back searches, and then park on the
+/// condition variable so that an idle engine does not burn CPU.
+
+void SFThread::wait_until(bool state) {
+
+  if (int spin = Threads.spinTime.load(std::memory_order_relaxed))
+  {
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(spin);
+
+      for (int i = 1; searching != state; ++i)
+      {
+          cpu_pause();
+
+          if (!(i & 63) && std::chrono::steady_clock::now() > deadline)
+              break;
+      }
+
+      if (searching == state)
+          return;
+  }
+
+  // Announce that we are going to sleep before checking the condition, so
+  // that whoever changes 'searching' sees us and notifies the condition
+  // variable (both operations are sequentially consistent).
+  std::unique_lock<std::mutex> lk(mutex);
+  ++parked;
+  cv.wait(lk, [&]{ return searching == state; });
+  --parked;
+}
+
+
+/// SFThread::wake_up() notifies the threads parked in wait_until(), if any.
+/// Spinning threads notice the change of 'searching' by themselves.
+
+void SFThread::wake_up() {
+
+  if (parked)
+  {
+      std::lock_guard<std::mutex> lk(mutex);
+      cv.notify_all();
+  }
+}
+
+
 /// SFThread::start_searching() wakes up the thread that will start the search
 
 void SFThread::start_searching() {
 
-  std::lock_guard<std::mutex> lk(mutex);
   searching = true;
-  cv.notify_one(); // Wake up the thread in idle_loop()
+  wake_up(); // Wake up the thread in idle_loop()
 }
 
 
-/// SFThread::wait_for_search_finished() blocks on the condition variable
-/// until the thread has finished searching.
+/// SFThread::wait_for_search_finished() blocks until the thread has finished
+/// searching.
 
 void SFThread::wait_for_search_finished() {
 
-  std::unique_lock<std::mutex> lk(mutex);
-  cv.wait(lk, [&]{ return !searching; });
+  wait_until(false);
 }
 
 
-/// SFThread::idle_loop() is where the thread is parked, blocked on the
-/// condition variable, when it has no work to do.
+/// SFThread::idle_loop() is where the thread waits, first spinning and then
+/// blocked on the condition variable, when it has no work to do.
 
 void SFThread::idle_loop() {
 
-  // If OS already scheduled us on a different group than 0 then don't overwrite
-  // the choice, eventually we are one of many one-threaded processes running on
-  // some Windows NUMA hardware, for instance in fishtest. To make it simple,
-  // just check if running threads are below a threshold, in this case all this
-  // NUMA machinery is not needed.
-  if (Options["Threads"] > 8)
+  // Bind the thread to its NUMA node, if requested by the "Thread Binding"
+  // option, before it first touches its per-thread tables.
+  if (WinProcGroup::binding_enabled())
       WinProcGroup::bindThisThread(idx);
 
   while (true)
   {
-      std::unique_lock<std::mutex> lk(mutex);
       searching = false;
-      cv.notify_one(); // Wake up anyone waiting for search finished
-      cv.wait(lk, [&]{ return searching; });
+      wake_up(); // Wake up anyone waiting for search finished
+      wait_until(true);
 
       if (exit)
           return;
 
-      lk.unlock();
+      // Helper threads set up their own root, so that the setup cost is
+      // paid in parallel while the main thread is already searching.
+      if (this != Threads.main())
+          Threads.setup_root(this);
 
       search();
   }
@@ -137,9 +208,16 @@ void SFThreadPool::set(size_t requested) {
       push_back(new MainThread(0));
 
       while (size() < requested)
-          push_back(new SFThread(size()));
+          push_back(new SFThread(size(), Options["Shared History"] ? main()->continuationHistory : nullptr));
       clear();
 
+      if (WinProcGroup::binding_enabled())
+      {
+          std::string info = WinProcGroup::binding_info(requested);
+          if (!info.empty())
+              sync_cout << "info string " << info << sync_endl;
+      }
+
       // Reallocate the hash with the new threadpool size
       TT.resize(size_t(Options["Hash"]));
 
@@ -153,8 +231,21 @@ void SFThreadPool::set(size_t requested) {
 
 void SFThreadPool::clear() {
 
+  std::vector<std::thread> threads;
+
+  // Each thread's tables are zeroed in parallel, by a thread bound like the
+  // searching one so that the pages are first touched on its NUMA node.
   for (SFThread* th : *this)
-      th->clear();
+      threads.emplace_back([th]() {
+
+          if (WinProcGroup::binding_enabled())
+              WinProcGroup::bindThisThread(th->idx);
+
+          th->clear();
+      });
+
+  for (std::thread& th : threads)
+      th.join();
 
   main()->callsCnt = 0;
   main()->bestPreviousScore = VALUE_INFINITE;
@@ -174,15 +265,61 @@ void SFThreadPool::start_thinking(Position& pos, StateListPtr& states,
   increaseDepth = true;
   main()->ponder = ponderMode;
   Search::Limits = limits;
-  Search::RootMoves rootMoves;
+  setupRootMoves.clear();
 
   for (const auto& m : MoveList<LEGAL>(pos))
       if (   limits.searchmoves.empty()
           || std::count(limits.searchmoves.begin(), limits.searchmoves.end(), m))
-          rootMoves.emplace_back(m);
+          setupRootMoves.emplace_back(m);
+
+  if (!setupRootMoves.empty())
+      Tablebases::rank_root_moves(pos, setupRootMoves);
+
+  // Search the expected best move first, seeding its PV in case the search is
+  // stopped before the first iteration is done.
+  if (!limits.rootPV.empty())
+  {
+      auto rm = std::find(setupRootMoves.begin(), setupRootMoves.end(), limits.rootPV[0]);
+
+      if (rm != setupRootMoves.end() && rm->tbRank == setupRootMoves[0].tbRank)
+      {
+          rm->pv = limits.rootPV;
+          std::rotate(setupRootMoves.begin(), rm, rm + 1);
+      }
+  }
+
+  // A resumed search goes on from the depth reached, with the lines found so
+  // far ranked first and their scores as previous scores. The other moves
+  // take the score of the last of them, so that any further PV line gets a
+  // sensible aspiration window. The search keeps them for its first iteration.
+  Depth startDepth = 0;
+
+  if (!limits.rootLines.empty())
+  {
+      size_t i = 0;
+
+      for ( ; i < limits.rootLines.size(); ++i)
+      {
+          const Search::RootMove& line = limits.rootLines[i];
+          auto rm = std::find(setupRootMoves.begin() + i, setupRootMoves.end(), line.pv[0]);
+
+          if (rm == setupRootMoves.end())
+              break;
+
+          rm->pv = line.pv;
+          rm->previousScore = line.score;
+          rm->selDepth = line.selDepth;
+          std::rotate(setupRootMoves.begin() + i, rm, rm + 1);
+      }
+
+      if (i == limits.rootLines.size())
+      {
+          startDepth = limits.startDepth;
 
-  if (!rootMoves.empty())
-      Tablebases::rank_root_moves(pos, rootMoves);
+          for ( ; i < setupRootMoves.size(); ++i)
+              setupRootMoves[i].previousScore = limits.rootLines.back().score;
+      }
+  }
 
   // After ownership transfer 'states' becomes empty, so if we stop the search
   // and call 'go' again without setting a new position states.get() == NULL.
@@ -191,23 +328,49 @@ void SFThreadPool::start_thinking(Position& pos, StateListPtr& states,
   if (states.get())
       setupStates = std::move(states); // Ownership transfer, states is now empty
 
-  // We use Position::set() to set root position across threads. But there are
-  // some StateInfo fields (previous, pliesFromNull, capturedPiece) that cannot
-  // be deduced from a fen string, so set() clears them and they are set from
-  // setupStates->back() later. The rootState is per thread, earlier states are shared
-  // since they are read-only.
+  // Keep a private copy of the root position: the helpers copy it when they
+  // start, while 'pos' belongs to the caller and the main thread's rootPos is
+  // already being searched. Counters are reset here because they are read
+  // across threads as soon as the main thread starts.
+  setupPos.set(pos, &setupStates->back(), nullptr);
+
   for (SFThread* th : *this)
   {
       th->nodes = th->tbHits = th->nmpMinPly = th->bestMoveChanges = 0;
-      th->rootDepth = th->completedDepth = 0;
-      th->rootMoves = rootMoves;
-      th->rootPos.set(pos.fen(), pos.is_chess960(), &th->rootState, th);
-      th->rootState = setupStates->back();
+      th->rootDepth = th->completedDepth = startDepth;
   }
 
+  main()->resultsStart = main()->results.head();
+  setup_root(main());
   main()->start_searching();
 }
 
+
+/// SFThreadPool::setup_root() copies the root position and the root moves
+/// prepared by start_thinking() into the given thread. The rootState is per
+/// thread, earlier states are shared since they are read-only.
+
+void SFThreadPool::setup_root(SFThread* th) const {
+
+  th->rootMoves = setupRootMoves;
+  th->rootState = setupStates->back();
+  th->rootPos.set(setupPos, &th->rootState, th);
+}
+
+
+/// SFThreadPool::stats() sums the search counters of all threads. Counters are
+/// read while threads may still be searching, so totals can be slightly stale.
+
+Search::SearchStats SFThreadPool::stats() const {
+
+  Search::SearchStats sum;
+  sum.clear();
+  for (SFThread* th : *this)
+      sum += th->stats;
+  return sum;
+}
+
+
 SFThread* SFThreadPool::get_best_thread() const {
 
     SFThread* bestThread = front();
@@ -240,13 +403,18 @@ SFThread* SFThreadPool::get_best_thread() const {
 }
 
 
-/// Start non-main threads
+/// Start non-main threads. All the threads are flagged first, so that the
+/// spinning ones start together, and only then the parked ones are notified.
 
 void SFThreadPool::start_searching() {
 
     for (SFThread* th : *this)
         if (th != front())
-            th->start_searching();
+            th->searching = true;
+
+    for (SFThread* th : *this)
+        if (th != front())
+            th->wake_up();
 }
 
 
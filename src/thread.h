@@ -21,10 +21,10 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <vector>
-#include <functional>
 
 #include "material.h"
 #include "movepick.h"
@@ -41,14 +41,23 @@
 
 class SFThread {
 
+  friend struct SFThreadPool;
+
   std::mutex mutex;
   std::condition_variable cv;
   size_t idx;
-  bool exit = false, searching = true; // Set before starting std::thread
+  bool exit = false; // Set before starting std::thread
+  std::atomic_bool searching { true };
+  std::atomic<int> parked { 0 };
   NativeThread stdThread;
 
+  void wait_until(bool state);
+  void wake_up();
+
+  std::unique_ptr<ContinuationHistory[][2]> ownContinuationHistory;
+
 public:
-  explicit SFThread(size_t);
+  explicit SFThread(size_t, ContinuationHistory (*sharedContinuationHistory)[2] = nullptr);
   virtual ~SFThread();
   virtual void search();
   void clear();
@@ -72,12 +81,12 @@ public:
   ButterflyHistory mainHistory;
   LowPlyHistory lowPlyHistory;
   CapturePieceToHistory captureHistory;
-  ContinuationHistory continuationHistory[2][2];
+  ContinuationHistory (*continuationHistory)[2]; // [inCheck][captureOrPromotion], own or shared
   Score contempt;
+  Search::SearchStats stats;
 
-  // CN
-  std::function<void(Move move, int depth, int selDepth, Value v)> pvCallback;
   int failedHighCnt;
+  Move rotatedBest; // Best move moved down by a root rotation, if any
 };
 
 
@@ -96,6 +105,8 @@ struct MainThread : public SFThread {
   int callsCnt;
   bool stopOnPonderhit;
   std::atomic_bool ponder;
+  Search::ResultRing results;
+  uint64_t resultsStart = 0; // Head of results when the last search started
 };
 
 
@@ -110,16 +121,22 @@ struct SFThreadPool : public std::vector<SFThread*> {
   void set(size_t);
 
   MainThread* main()        const { return static_cast<MainThread*>(front()); }
+  const Position& root()    const { return setupPos; } // Of the last search started
   uint64_t nodes_searched() const { return accumulate(&SFThread::nodes); }
   uint64_t tb_hits()        const { return accumulate(&SFThread::tbHits); }
+  Search::SearchStats stats() const;
   SFThread* get_best_thread() const;
   void start_searching();
   void wait_for_search_finished() const;
+  void setup_root(SFThread* th) const;
 
   std::atomic_bool stop, increaseDepth;
+  std::atomic<int> spinTime; // Microseconds to spin before parking a thread
 
 private:
   StateListPtr setupStates;
+  Position setupPos;
+  Search::RootMoves setupRootMoves;
 
   uint64_t accumulate(std::atomic<uint64_t> SFThread::* member) const {
 
@@ -90,7 +90,7 @@ void TranspositionTable::clear() {
       threads.emplace_back([this, idx]() {
 
           // SFThread binding gives faster search on systems with a first-touch policy
-          if (Options["Threads"] > 8)
+          if (WinProcGroup::binding_enabled())
               WinProcGroup::bindThisThread(idx);
 
           // Each thread will zero its part of the hash table
@@ -115,7 +115,9 @@ void TranspositionTable::clear() {
 /// minus 8 times its relative age. TTEntry t1 is considered more valuable than
 /// TTEntry t2 if its replace value is greater than that of t2.
 
-TTEntry* TranspositionTable::probe(const Key key, bool& found) const {
+PERF_NOINLINE TTEntry* TranspositionTable::probe(const Key key, bool& found) const {
+
+  PhaseTimer timer(PHASE_TT_PROBE);
 
   TTEntry* const tte = first_entry(key);
   const uint16_t key16 = (uint16_t)key;  // Use the low 16 bits as key inside the cluster
@@ -155,3 +157,35 @@ int TranspositionTable::hashfull() const {
 
   return cnt / ClusterSize;
 }
+
+
+/// TranspositionTable::save() writes the table and its generation to a binary
+/// stream, as is: entries being written meanwhile by a search may be torn, as
+/// in the table itself. TranspositionTable::load() reads them back into a table
+/// of the same size, returning false if the sizes differ or the read fails.
+
+bool TranspositionTable::save(std::ostream& os) const {
+
+  uint64_t count = clusterCount;
+
+  os.write(reinterpret_cast<const char*>(&count), sizeof(count));
+  os.put(char(generation8));
+  os.write(reinterpret_cast<const char*>(table), std::streamsize(clusterCount * sizeof(Cluster)));
+
+  return bool(os);
+}
+
+bool TranspositionTable::load(std::istream& is) {
+
+  uint64_t count = 0;
+  char generation = 0;
+
+  if (   !is.read(reinterpret_cast<char*>(&count), sizeof(count))
+      || count != clusterCount
+      || !is.get(generation))
+      return false;
+
+  generation8 = uint8_t(generation);
+
+  return bool(is.read(reinterpret_cast<char*>(table), std::streamsize(clusterCount * sizeof(Cluster))));
+}
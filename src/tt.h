@@ -19,6 +19,8 @@
 #ifndef TT_H_INCLUDED
 #define TT_H_INCLUDED
 
+#include <iosfwd>
+
 #include "misc.h"
 #include "types.h"
 
@@ -79,6 +81,8 @@ public:
   int hashfull() const;
   void resize(size_t mbSize);
   void clear();
+  bool save(std::ostream& os) const;
+  bool load(std::istream& is);
 
   TTEntry* first_entry(const Key key) const {
     return &table[mul_hi64(key, clusterCount)].entry[0];
@@ -35,6 +35,18 @@
 ///
 /// -DUSE_PEXT    | Add runtime support for use of pext asm-instruction. Works
 ///               | only in 64-bit mode and requires hardware with pext support.
+///
+/// -DCOMPACT_ATTACKS | Store slider attacks as byte indices into the distinct
+///               | attack sets, for less cache pressure next to other engines.
+///
+/// -DSEARCH_STATS | Count search events (pruning, cutoffs, cache hits) per
+///               | thread, see the 'stats' command.
+///
+/// -DPERF_BUILD  | Keep the hot phases (NNUE accumulator and layers, move
+///               | generation, SEE, hash probes) out of line for profilers.
+///
+/// -DPERF_PHASES | Time the hot phases with the cycle counter, the breakdown
+///               | is printed after bench.
 
 #include <cassert>
 #include <cctype>
@@ -63,6 +75,14 @@
 
 #define ASSERT_ALIGNED(ptr, alignment) assert(reinterpret_cast<uintptr_t>(ptr) % alignment == 0)
 
+#if !defined(PERF_BUILD)
+#  define PERF_NOINLINE
+#elif defined(_MSC_VER)
+#  define PERF_NOINLINE __declspec(noinline)
+#else
+#  define PERF_NOINLINE __attribute__((noinline))
+#endif
+
 #if defined(_WIN64) && defined(_MSC_VER) // No Makefile used
 #  include <intrin.h> // Microsoft header for _BitScanForward64()
 #  define IS_64BIT
@@ -101,6 +121,18 @@ constexpr bool HasAvx2 = true;
 constexpr bool HasAvx2 = false;
 #endif
 
+#ifdef SEARCH_STATS
+constexpr bool HasSearchStats = true;
+#else
+constexpr bool HasSearchStats = false;
+#endif
+
+#ifdef PERF_PHASES
+constexpr bool HasPerfPhases = true;
+#else
+constexpr bool HasPerfPhases = false;
+#endif
+
 #ifdef IS_64BIT
 constexpr bool Is64Bit = true;
 constexpr bool Is32Bit = false;
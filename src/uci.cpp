@@ -16,16 +16,21 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string>
 
+#include "builder.h"
+#include "checkpoint.h"
 #include "evaluate.h"
 #include "movegen.h"
 #include "position.h"
 #include "search.h"
+#include "server.h"
 #include "thread.h"
 #include "timeman.h"
 #include "tt.h"
@@ -42,40 +47,6 @@ namespace {
   const char* StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 
 
-  // position() is called when engine receives the "position" UCI command.
-  // The function sets up the position described in the given FEN string ("fen")
-  // or the starting position ("startpos") and then makes the moves given in the
-  // following move list ("moves").
-
-  void position(Position& pos, istringstream& is, StateListPtr& states) {
-
-    Move m;
-    string token, fen;
-
-    is >> token;
-
-    if (token == "startpos")
-    {
-        fen = StartFEN;
-        is >> token; // Consume "moves" token if any
-    }
-    else if (token == "fen")
-        while (is >> token && token != "moves")
-            fen += token + " ";
-    else
-        return;
-
-    states = StateListPtr(new std::deque<StateInfo>(1)); // Drop old and create a new one
-    pos.set(fen, Options["UCI_Chess960"], &states->back(), Threads.main());
-
-    // Parse move list (if any)
-    while (is >> token && (m = UCI::to_move(pos, token)) != MOVE_NONE)
-    {
-        states->emplace_back();
-        pos.do_move(m, states->back());
-    }
-  }
-
   // trace_eval() prints the evaluation for the current position, consistent with the UCI
   // options set so far.
 
@@ -121,29 +92,8 @@ namespace {
 
   void go(Position& pos, istringstream& is, StateListPtr& states) {
 
-    Search::LimitsType limits;
-    string token;
     bool ponderMode = false;
-
-    limits.startTime = now(); // As early as possible!
-
-    while (is >> token)
-        if (token == "searchmoves") // Needs to be the last command on the line
-            while (is >> token)
-                limits.searchmoves.push_back(UCI::to_move(pos, token));
-
-        else if (token == "wtime")     is >> limits.time[WHITE];
-        else if (token == "btime")     is >> limits.time[BLACK];
-        else if (token == "winc")      is >> limits.inc[WHITE];
-        else if (token == "binc")      is >> limits.inc[BLACK];
-        else if (token == "movestogo") is >> limits.movestogo;
-        else if (token == "depth")     is >> limits.depth;
-        else if (token == "nodes")     is >> limits.nodes;
-        else if (token == "movetime")  is >> limits.movetime;
-        else if (token == "mate")      is >> limits.mate;
-        else if (token == "perft")     is >> limits.perft;
-        else if (token == "infinite")  limits.infinite = 1;
-        else if (token == "ponder")    ponderMode = true;
+    Search::LimitsType limits = UCI::limits(pos, is, ponderMode);
 
     Threads.start_thinking(pos, states, limits, ponderMode);
   }
@@ -162,6 +112,7 @@ namespace {
     num = count_if(list.begin(), list.end(), [](string s) { return s.find("go ") == 0 || s.find("eval") == 0; });
 
     TimePoint elapsed = now();
+    uint64_t cycles = cpu_cycles();
 
     for (const auto& cmd : list)
     {
@@ -181,11 +132,18 @@ namespace {
                trace_eval(pos);
         }
         else if (token == "setoption")  setoption(is);
-        else if (token == "position")   position(pos, is, states);
-        else if (token == "ucinewgame") { Search::clear(); elapsed = now(); } // Search::clear() may take some while
+        else if (token == "position")   UCI::position(pos, is, states);
+        else if (token == "ucinewgame") // Search::clear() may take some while
+        {
+            Search::clear();
+            elapsed = now();
+            cycles = cpu_cycles();
+            phase_clear();
+        }
     }
 
     elapsed = now() - elapsed + 1; // Ensure positivity to avoid a 'divide by zero'
+    cycles = cpu_cycles() - cycles;
 
     dbg_print(); // Just before exiting
 
@@ -193,6 +151,203 @@ namespace {
          << "\nTotal time (ms) : " << elapsed
          << "\nNodes searched  : " << nodes
          << "\nNodes/second    : " << 1000 * nodes / elapsed << endl;
+
+    if (HasSearchStats)
+        cerr << "\n" << Search::stats_report(Threads.stats()) << endl;
+
+    if (HasPerfPhases)
+        phase_print(cycles);
+  }
+
+  // latency() is called when engine receives the "latency" command. It runs a
+  // series of very short searches on the current position and reports their
+  // round trip time, from start_thinking() until all the threads are parked
+  // again, which at low depth is dominated by waking up and collecting threads.
+  //
+  // latency -> 1000 searches at depth 1
+  // latency 200 3 -> 200 searches at depth 3
+
+  void latency(Position& pos, istream& is, StateListPtr& states) {
+
+    string token;
+    int count = std::max((is >> token) ? std::atoi(token.c_str()) : 1000, 1);
+    int depth = std::max((is >> token) ? std::atoi(token.c_str()) : 1, 1);
+
+    vector<int64_t> samples;
+    std::cout.setstate(std::ios::failbit); // Keep output cost out of the samples
+
+    for (int i = 0; i < count; ++i)
+    {
+        Search::LimitsType limits;
+        limits.startTime = now();
+        limits.depth = depth;
+
+        auto start = std::chrono::steady_clock::now();
+        Threads.start_thinking(pos, states, limits);
+        Threads.main()->wait_for_search_finished();
+        samples.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - start).count());
+    }
+
+    std::cout.clear();
+    std::sort(samples.begin(), samples.end());
+
+    int64_t total = 0;
+    for (int64_t t : samples)
+        total += t;
+
+    cerr << "\n==========================="
+         << "\nThreads         : " << Threads.size()
+         << "\nSpin Wait (us)  : " << Threads.spinTime
+         << "\nSearches        : " << count << " at depth " << depth
+         << "\nAverage (us)    : " << total / count
+         << "\nMin (us)        : " << samples.front()
+         << "\nMedian (us)     : " << samples[count / 2]
+         << "\n99th perc. (us) : " << samples[count * 99 / 100]
+         << "\nMax (us)        : " << samples.back() << endl;
+  }
+
+  // smpbench() is called when engine receives the "smpbench" command. It runs
+  // the bench positions (same arguments as bench) once for each combination of
+  // the "SMP Depth Skip" and "SMP Root Split" schedules and reports the time to
+  // reach the given depth and the best move stability, i.e. the average share
+  // of the main thread iterations which already had the final best move.
+  //
+  // smpbench 16 4 16 -> compare schedules with 4 threads up to depth 16
+
+  void smpbench(Position& pos, istream& args, StateListPtr& states) {
+
+    string token, argList;
+    while (args >> token)
+        argList += token + " ";
+
+    const char* Schedules[][2] = { { "Off", "Off" }, { "Classic", "Off" },
+                                   { "Off", "Rotate" }, { "Classic", "Rotate" } };
+    string report, skip = Options["SMP Depth Skip"], split = Options["SMP Root Split"];
+
+    for (const auto& sc : Schedules)
+    {
+        Options["SMP Depth Skip"] = string(sc[0]);
+        Options["SMP Root Split"] = string(sc[1]);
+
+        istringstream argStream(argList);
+        vector<string> list = setup_bench(pos, argStream);
+        TimePoint elapsed = 0;
+        uint64_t nodes = 0;
+        double stability = 0;
+        int cnt = 0;
+
+        std::cout.setstate(std::ios::failbit);
+
+        for (const auto& cmd : list)
+        {
+            istringstream is(cmd);
+            is >> skipws >> token;
+
+            if (token == "go")
+            {
+                // Record the best move reported after each main thread iteration
+                vector<Move> bestMoves;
+                auto subscriber = Threads.main()->results.subscriber;
+                Threads.main()->results.subscriber = [&](const Search::PVRecord& r) {
+                    if (r.multiPV == 1)
+                        bestMoves.push_back(r.move());
+                };
+
+                TimePoint start = now();
+                go(pos, is, states);
+                Threads.main()->wait_for_search_finished();
+                elapsed += now() - start;
+                nodes += Threads.nodes_searched();
+                Threads.main()->results.subscriber = subscriber;
+
+                if (!bestMoves.empty())
+                    stability += double(count(bestMoves.begin(), bestMoves.end(), bestMoves.back()))
+                                / bestMoves.size();
+                cnt++;
+            }
+            else if (token == "setoption")  setoption(is);
+            else if (token == "position")   UCI::position(pos, is, states);
+            else if (token == "ucinewgame") Search::clear();
+        }
+
+        std::cout.clear();
+
+        ostringstream ss;
+        ss << "\n" << setw(8) << sc[0] << setw(8) << sc[1]
+           << setw(12) << elapsed << setw(14) << nodes
+           << setw(12) << fixed << setprecision(3) << stability / std::max(cnt, 1);
+        report += ss.str();
+    }
+
+    Options["SMP Depth Skip"] = skip;
+    Options["SMP Root Split"] = split;
+
+    cerr << "\n==========================="
+         << "\n    Skip   Split   Time (ms)         Nodes   Stability"
+         << report << endl;
+  }
+
+  // build_book() is called when engine receives the "buildbook" command. It
+  // reads the seed file and the options after it, then analyzes the positions
+  // and writes a Polyglot book or an analysis file, see Builder::build().
+  //
+  // buildbook lines.pgn book.bin depth 24 plies 6 jobs 4 -> Polyglot book
+  // buildbook openings.epd deep.adb depth 30             -> analysis file
+
+  void build_book(istringstream& is) {
+
+    Builder::Params params;
+    string token;
+
+    is >> params.seedFile >> params.outFile;
+
+    while (is >> token)
+        if (token == "depth")       is >> params.depth;
+        else if (token == "plies")  is >> params.plies;
+        else if (token == "margin") is >> params.margin;
+        else if (token == "jobs")   is >> params.jobs;
+
+    if (params.outFile.empty())
+    {
+        sync_cout << "info string Usage: buildbook <seed file> <output file>"
+                     " [depth N] [plies N] [margin N] [jobs N]" << sync_endl;
+        return;
+    }
+
+    params.depth = std::clamp(params.depth, 1, 255);
+    Builder::build(params);
+  }
+
+  // resume() is called when engine receives the "resume" command. It stops the
+  // search, if any, restores a checkpoint and goes on with its search, infinite
+  // unless "go" parameters follow the file name.
+  //
+  // resume analysis.ckpt                -> go infinite from the checkpoint
+  // resume analysis.ckpt movetime 60000 -> search for another minute
+
+  void resume(Position& pos, istringstream& is, StateListPtr& states) {
+
+    Search::LimitsType saved;
+    bool ponderMode = false;
+    string path;
+
+    is >> path;
+    Threads.stop = true;
+    Threads.main()->wait_for_search_finished();
+
+    if (!Checkpoint::load(path, pos, states, saved))
+        return;
+
+    Search::LimitsType limits = UCI::limits(pos, is, ponderMode);
+
+    if (!(   limits.use_time_management() || limits.movetime || limits.depth
+          || limits.nodes || limits.mate || limits.perft))
+        limits.infinite = 1;
+
+    limits.startDepth = saved.startDepth;
+    limits.rootLines = saved.rootLines;
+    Threads.start_thinking(pos, states, limits, ponderMode);
   }
 
   // The win rate model returns the probability (per mille) of winning given an eval
@@ -264,7 +419,7 @@ void UCI::loop(int argc, char* argv[]) {
 
       else if (token == "setoption")  setoption(is);
       else if (token == "go")         go(pos, is, states);
-      else if (token == "position")   position(pos, is, states);
+      else if (token == "position")   UCI::position(pos, is, states);
       else if (token == "ucinewgame") Search::clear();
       else if (token == "isready")    sync_cout << "readyok" << sync_endl;
 
@@ -272,9 +427,17 @@ void UCI::loop(int argc, char* argv[]) {
       // Do not use these commands during a search!
       else if (token == "flip")     pos.flip();
       else if (token == "bench")    bench(pos, is, states);
+      else if (token == "latency")  latency(pos, is, states);
+      else if (token == "smpbench") smpbench(pos, is, states);
       else if (token == "d")        sync_cout << pos << sync_endl;
       else if (token == "eval")     trace_eval(pos);
+      else if (token == "stats")    sync_cout << Search::stats_report(Threads.stats()) << sync_endl;
       else if (token == "compiler") sync_cout << compiler_info() << sync_endl;
+      else if (token == "server")   { string path; is >> path; if (Server::run(path, argc == 1)) break; }
+      else if (token == "buildbook") build_book(is);
+      else if (token == "checkpoint") { string path; is >> path; Checkpoint::save(path); }
+      else if (token == "resume")   resume(pos, is, states);
+      else if (token == "forkserver") { string path; is >> path; if (Server::fork_workers(path, argc == 1)) break; }
       else
           sync_cout << "Unknown command: " << cmd << sync_endl;
 
@@ -282,6 +445,73 @@ void UCI::loop(int argc, char* argv[]) {
 }
 
 
+/// UCI::position() is called when engine receives the "position" UCI command.
+/// The function sets up the position described in the given FEN string ("fen")
+/// or the starting position ("startpos") and then makes the moves given in the
+/// following move list ("moves").
+
+void UCI::position(Position& pos, istringstream& is, StateListPtr& states) {
+
+  Move m;
+  string token, fen;
+
+  is >> token;
+
+  if (token == "startpos")
+  {
+      fen = StartFEN;
+      is >> token; // Consume "moves" token if any
+  }
+  else if (token == "fen")
+      while (is >> token && token != "moves")
+          fen += token + " ";
+  else
+      return;
+
+  states = StateListPtr(new std::deque<StateInfo>(1)); // Drop old and create a new one
+  pos.set(fen, Options["UCI_Chess960"], &states->back(), Threads.main());
+
+  // Parse move list (if any)
+  while (is >> token && (m = UCI::to_move(pos, token)) != MOVE_NONE)
+  {
+      states->emplace_back();
+      pos.do_move(m, states->back());
+  }
+}
+
+
+/// UCI::limits() parses the arguments of the "go" UCI command into the search
+/// limits, setting ponderMode if asked to ponder.
+
+Search::LimitsType UCI::limits(const Position& pos, istringstream& is, bool& ponderMode) {
+
+  Search::LimitsType limits;
+  string token;
+
+  limits.startTime = now(); // As early as possible!
+
+  while (is >> token)
+      if (token == "searchmoves") // Needs to be the last command on the line
+          while (is >> token)
+              limits.searchmoves.push_back(UCI::to_move(pos, token));
+
+      else if (token == "wtime")     is >> limits.time[WHITE];
+      else if (token == "btime")     is >> limits.time[BLACK];
+      else if (token == "winc")      is >> limits.inc[WHITE];
+      else if (token == "binc")      is >> limits.inc[BLACK];
+      else if (token == "movestogo") is >> limits.movestogo;
+      else if (token == "depth")     is >> limits.depth;
+      else if (token == "nodes")     is >> limits.nodes;
+      else if (token == "movetime")  is >> limits.movetime;
+      else if (token == "mate")      is >> limits.mate;
+      else if (token == "perft")     is >> limits.perft;
+      else if (token == "infinite")  limits.infinite = 1;
+      else if (token == "ponder")    ponderMode = true;
+
+  return limits;
+}
+
+
 /// UCI::value() converts a Value to a string suitable for use with the UCI
 /// protocol specification:
 ///
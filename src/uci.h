@@ -20,12 +20,13 @@
 #define UCI_H_INCLUDED
 
 #include <map>
+#include <sstream>
 #include <string>
 
+#include "position.h"
+#include "search.h"
 #include "types.h"
 
-class Position;
-
 namespace UCI {
 
 class Option;
@@ -73,6 +74,8 @@ std::string move(Move m, bool chess960);
 std::string pv(const Position& pos, Depth depth, Value alpha, Value beta);
 std::string wdl(Value v, int ply);
 Move to_move(const Position& pos, std::string& str);
+void position(Position& pos, std::istringstream& is, StateListPtr& states);
+Search::LimitsType limits(const Position& pos, std::istringstream& is, bool& ponderMode);
 
 } // namespace UCI
 
@@ -22,6 +22,7 @@
 #include <sstream>
 #include <thread>
 
+#include "bitboard.h"
 #include "evaluate.h"
 #include "misc.h"
 #include "search.h"
@@ -30,6 +31,7 @@
 #include "uci.h"
 #include "syzygy/tbprobe.h"
 #include "polybook.h"
+#include "analysisdb.h"
 
 using std::string;
 
@@ -42,6 +44,9 @@ void on_clear_hash(const Option&) { Search::clear(); }
 void on_hash_size(const Option& o) { TT.resize(size_t(o)); }
 void on_logger(const Option& o) { start_logger(o); }
 void on_threads(const Option& o) { Threads.set(size_t(o)); }
+void on_thread_binding(const Option&) { Threads.set(size_t(Options["Threads"])); }
+void on_shared_history(const Option&) { Threads.set(size_t(Options["Threads"])); }
+void on_spin_wait(const Option& o) { Threads.spinTime = int(o); }
 void on_tb_path(const Option& o) { Tablebases::init(o); }
 void on_book_file(const Option& o) { polybook.init(o); }
 void on_book_file2(const Option& o) { polybook2.init(o); }
@@ -49,8 +54,13 @@ void on_book_file3(const Option& o) { polybook3.init(o); }
 void on_book_file4(const Option& o) { polybook4.init(o); }
 void on_best_book_move(const Option& o) { polybook.set_best_book_move(o); }
 void on_book_depth(const Option& o) { polybook.set_book_depth(o); }
+void on_analysis_file(const Option& o) { analysisdb.init(o); }
 void on_use_NNUE(const Option& ) { Eval::NNUE::init(); }
 void on_eval_file(const Option& ) { Eval::NNUE::init(); }
+void on_slider_attacks(const Option& o) {
+  Threads.main()->wait_for_search_finished();
+  sync_cout << "info string Slider attacks: " << Bitboards::init_sliders(o) << sync_endl;
+}
 
 /// Our case insensitive less() function as required by UCI protocol
 bool CaseInsensitiveLess::operator() (const string& s1, const string& s2) const {
@@ -73,10 +83,18 @@ void init(OptionsMap& o) {
   o["Contempt"]              << Option(0, -100, 100); // contempt returns to 0
   o["Analysis Contempt"]     << Option("Both var Off var White var Black var Both", "Off"); // Analysis Contempt Off
   o["Threads"]               << Option(max_threads, 1, 512, on_threads); // sets the maximum number of threads as default
+  o["Thread Binding"]        << Option("Auto var Auto var Off var Compact var Spread", "Auto", on_thread_binding);
+  o["Thread CPU Set"]        << Option("<empty>", on_thread_binding);
+  o["Spin Wait"]             << Option(0, 0, 100000, on_spin_wait);
+  o["SMP Depth Skip"]        << Option("Off var Off var Classic", "Off");
+  o["SMP Root Split"]        << Option("Off var Off var Rotate", "Off");
+  o["Shared History"]        << Option(false, on_shared_history);
+  o["Slider Attacks"]        << Option("Auto var Auto var Magic var Pext", "Auto", on_slider_attacks);
   o["Hash"]                  << Option(16, 1, MaxHashMB, on_hash_size);
   o["Clear Hash"]            << Option(on_clear_hash);
   o["Ponder"]                << Option(false);
   o["MultiPV"]               << Option(1, 1, 500);
+  o["MultiPV Reduction"]     << Option(0, 0, 90);
   o["Skill Level"]           << Option(20, 0, 20);
   o["Move Overhead"]         << Option(10, 0, 5000);
   o["Slow Mover"]            << Option(100, 10, 1000);
@@ -97,8 +115,12 @@ void init(OptionsMap& o) {
   o["BookFile 4"]            << Option("", on_book_file4);
   o["BestBookMove"]          << Option(false, on_best_book_move); /// having this function disabled avoids repetitions in books testing
   o["BookDepth"]             << Option(255, 1, 255, on_book_depth);
+  o["Analysis File"]         << Option("", on_analysis_file);
+  o["Analysis Min Depth"]    << Option(1, 1, 255);
   o["Use NNUE"]              << Option(true, on_use_NNUE);
   o["EvalFile"]              << Option(EvalFileDefaultName, on_eval_file);
+  o["Server Sessions"]       << Option(64, 1, 4096);
+  o["Server Move Time"]      << Option(10000, 10, 3600000);
 }
 
 